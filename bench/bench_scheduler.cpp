@@ -0,0 +1,69 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "bench_utils.h"
+#include "task_timetable/scheduler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+constexpr auto kDuration = 2s;
+
+// Many short repeating tasks, i.e. a scheduler dominated by re-arming.
+void rearmRepeatingTasks(std::size_t nTasks, std::chrono::milliseconds period,
+                         unsigned nExecutors)
+{
+    std::atomic_size_t runs{0};
+    ttt::CallScheduler plan(true, nExecutors);
+
+    std::vector<std::pair<std::function<ttt::Result()>,
+                          std::chrono::microseconds>>
+        calls;
+    calls.reserve(nTasks);
+    for (std::size_t i = 0; i < nTasks; ++i)
+    {
+        calls.emplace_back(
+            [&runs] {
+                runs.fetch_add(1, std::memory_order_relaxed);
+                return ttt::Result::Repeat;
+            },
+            period);
+    }
+
+    auto tokens = plan.add(std::move(calls), true);
+    auto const before = plan.metrics();
+    auto const runsBefore = runs.load();
+    auto elapsed =
+        bench::measure([] { std::this_thread::sleep_for(kDuration); });
+    auto const after = plan.metrics();
+    auto const nRuns = runs.load() - runsBefore;
+    auto const stats = plan.laneStats(ttt::kDefaultLane);
+
+    bench::report("re-arm - " + std::to_string(nTasks) + " tasks", elapsed,
+                  nRuns);
+    std::printf("    %zu runs, %llu coordinator wake ups, %.1f ms max lag\n",
+                nRuns,
+                static_cast<unsigned long long>(after.wakeups -
+                                                before.wakeups),
+                static_cast<double>(stats->maxDelay.count()) / 1e3);
+}
+
+} // namespace
+
+// Throughput of a scheduler whose tasks repeat at short periods, along with
+// the coordinator wake ups and the lag of tasks behind their due time.
+int main()
+{
+    rearmRepeatingTasks(10'000, 10ms, 1);
+    rearmRepeatingTasks(100'000, 100ms, 2);
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "bench_utils.h"
+#include "task_timetable/timeline.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::vector<std::string> makeStates(std::size_t nTimers)
+{
+    std::vector<std::string> ret;
+    ret.reserve(nTimers);
+
+    for (std::size_t i = 0; i < nTimers; ++i)
+    {
+        // Stopped timers, i.e. no scheduler activity.
+        ret.emplace_back("timer:session_timer_" + std::to_string(i) + ":100:" +
+                         std::to_string(60'000 + i) + ":" +
+                         std::to_string(30'000 + i) + ":1:0");
+    }
+
+    return ret;
+}
+
+} // namespace
+
+// Checkpoint and restore costs of a timeline, per timer.
+int main()
+{
+    const std::size_t nTimers = 1'000'000;
+    auto const states = makeStates(nTimers);
+
+    ttt::Timeline *restored = nullptr;
+    auto loadText = bench::measure(
+        [&] { restored = new ttt::Timeline(states, [](auto const &) {}); });
+    bench::report("text: load", loadText, nTimers);
+
+    std::vector<std::string> checkpoint;
+    auto saveText = bench::measure(
+        [&] { checkpoint = restored->serialize(true, true, true); });
+    bench::report("text: serialize", saveText, nTimers);
+
+    std::vector<std::byte> image;
+    auto saveBinary =
+        bench::measure([&] { restored->serialize(image, true, true, true); });
+    bench::report("binary: serialize", saveBinary, nTimers);
+    delete restored;
+
+    auto loadBinary = bench::measure(
+        [&] { restored = new ttt::Timeline(image, [](auto const &) {}); });
+    bench::report("binary: load", loadBinary, nTimers);
+    std::printf("binary image: %zu bytes/timer\n", image.size() / nTimers);
+
+    delete restored;
+    return 0;
+}
@@ -0,0 +1,35 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace bench
+{
+
+inline auto now()
+{
+    return std::chrono::steady_clock::now();
+}
+
+// Time a single invocation of the callable.
+template <class F> std::chrono::nanoseconds measure(F &&fun)
+{
+    auto start = now();
+    fun();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now() -
+                                                                 start);
+}
+
+// Print the per operation cost of a measurement.
+inline void report(std::string const &name, std::chrono::nanoseconds total,
+                   std::size_t nOps)
+{
+    std::printf("%-48s %12.1f ns/op %10.1f ms total\n", name.c_str(),
+                double(total.count()) / double(nOps),
+                double(total.count()) / 1e6);
+}
+
+} // namespace bench
@@ -0,0 +1,85 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "bench_utils.h"
+#include "task_timetable/buffered_worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+
+using task_t = std::function<void()>;
+
+// Stream of tasks to a consumer that is kept busy, i.e. the consumer is
+// processing the front buffer while the producer fills the back one.
+void addToBusyConsumer(std::size_t nTasks)
+{
+    std::atomic_size_t done{0};
+    ttt::BufferedWorker<task_t> worker(nTasks);
+
+    auto elapsed = bench::measure([&] {
+        for (std::size_t i = 0; i < nTasks; ++i)
+        {
+            worker.add(
+                [&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+    });
+
+    while (done.load() != nTasks)
+    {
+        std::this_thread::yield();
+    }
+
+    bench::report("add() - busy consumer", elapsed, nTasks);
+}
+
+// Bursts of tasks, each one arriving while the consumer is parked.
+void addToParkedConsumer(std::size_t nBursts, std::size_t burstLen)
+{
+    std::atomic_size_t done{0};
+    ttt::BufferedWorker<task_t> worker(burstLen);
+    std::chrono::nanoseconds elapsed{0};
+
+    for (std::size_t b = 1; b <= nBursts; ++b)
+    {
+        // Give the consumer time to drain its buffers and go to sleep.
+        while (done.load() != (b - 1) * burstLen)
+        {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(50us);
+
+        elapsed += bench::measure([&] {
+            for (std::size_t i = 0; i < burstLen; ++i)
+            {
+                worker.add(
+                    [&done] { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+
+    while (done.load() != nBursts * burstLen)
+    {
+        std::this_thread::yield();
+    }
+
+    bench::report("add() - bursts to parked consumer", elapsed,
+                  nBursts * burstLen);
+}
+
+} // namespace
+
+// Producer side cost of BufferedWorker::add, i.e. the time spent by the thread
+// submitting work, for the two regimes a worker alternates between.
+int main()
+{
+    addToBusyConsumer(1'000'000);
+    addToParkedConsumer(2'000, 64);
+
+    return 0;
+}
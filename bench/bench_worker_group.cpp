@@ -0,0 +1,122 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "bench_utils.h"
+#include "task_timetable/buffered_worker.h"
+#include "task_timetable/worker_group.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+using task_t = std::function<void()>;
+
+// Burn cpu for the specified amount of time.
+void spin(std::chrono::microseconds d)
+{
+    auto const end = bench::now() + d;
+    while (bench::now() < end)
+    {
+    }
+}
+
+// Task cost in microseconds. One in every nWorkers tasks is an order of
+// magnitude heavier, which is what defeats static (round-robin) distribution.
+std::chrono::microseconds costOf(std::size_t i, unsigned nWorkers)
+{
+    return std::chrono::microseconds(0 == i % nWorkers ? 50 : 5);
+}
+
+void waitFor(std::atomic_size_t const &done, std::size_t n)
+{
+    while (done.load() != n)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void roundRobinWorkers(unsigned nWorkers, std::size_t nTasks)
+{
+    std::atomic_size_t done{0};
+    std::deque<ttt::BufferedWorker<task_t>> workers;
+    for (unsigned i = 0; i < nWorkers; ++i)
+    {
+        workers.emplace_back(nTasks);
+    }
+
+    auto elapsed = bench::measure([&] {
+        for (std::size_t i = 0; i < nTasks; ++i)
+        {
+            workers[i % nWorkers].add([&done, cost = costOf(i, nWorkers)] {
+                spin(cost);
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        waitFor(done, nTasks);
+    });
+
+    bench::report(std::to_string(nWorkers) + " x BufferedWorker (round-robin)",
+                  elapsed, nTasks);
+}
+
+void workerGroup(unsigned nWorkers, std::size_t nTasks)
+{
+    std::atomic_size_t done{0};
+    ttt::WorkerGroup<task_t> group(nWorkers, nTasks);
+
+    auto elapsed = bench::measure([&] {
+        for (std::size_t i = 0; i < nTasks; ++i)
+        {
+            group.add([&done, cost = costOf(i, nWorkers)] {
+                spin(cost);
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        waitFor(done, nTasks);
+    });
+
+    bench::report("WorkerGroup of " + std::to_string(nWorkers), elapsed,
+                  nTasks);
+}
+
+void emptyTasks(unsigned nWorkers, std::size_t nTasks)
+{
+    std::atomic_size_t done{0};
+    ttt::WorkerGroup<task_t> group(nWorkers, nTasks);
+
+    auto elapsed = bench::measure([&] {
+        for (std::size_t i = 0; i < nTasks; ++i)
+        {
+            group.add(
+                [&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        waitFor(done, nTasks);
+    });
+
+    bench::report("WorkerGroup of " + std::to_string(nWorkers) +
+                      " (empty tasks)",
+                  elapsed, nTasks);
+}
+
+} // namespace
+
+// Time to complete a batch of cpu bound tasks with skewed costs, on M
+// independent workers fed round-robin vs a group of M consumers sharing a
+// queue. The costs are skewed so that, under round-robin, all heavy tasks land
+// on the same worker. Run on a machine with at least M cores.
+int main()
+{
+    auto const nWorkers = std::max(2u, std::thread::hardware_concurrency());
+
+    roundRobinWorkers(nWorkers, 20'000);
+    workerGroup(nWorkers, 20'000);
+    emptyTasks(nWorkers, 1'000'000);
+
+    return 0;
+}
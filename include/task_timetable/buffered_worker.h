@@ -1,8 +1,11 @@
 // © 2022 Nikolaos Athanasiou, github.com/picanumber
 #pragma once
 
+#include "tracer.h"
+
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <mutex>
 #include <queue>
@@ -24,6 +27,7 @@ constexpr char kErrorWorkerSize[] = "Worker cannot have a zero length buffer";
  *
  * @details Features:
  * - Doubly buffered production/consumption of task items.
+ * - Producers only signal the consumer when it is parked waiting for data.
  *
  * @tparam TaskType type of the unit of work.
  */
@@ -64,15 +68,34 @@ template <class TaskType> class BufferedWorker
         if (!_stop)
         {
             ret = true;
-            std::lock_guard<std::mutex> lock(_mtx);
+            bool wakeConsumer = false;
 
-            if (_back->size() >= _maxLen)
             {
-                _back->pop();
+                std::lock_guard<std::mutex> lock(_mtx);
+
+                if (_back->size() >= _maxLen)
+                {
+                    _back->pop();
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    detail::trace('i', "drop");
+                }
+                else
+                {
+                    _pending.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                _back->emplace(std::move(work));
+
+                // A parked consumer only needs a single signal, issued on the
+                // empty to non-empty transition of the back buffer.
+                wakeConsumer = _parked;
+                _parked = false;
             }
 
-            _back->emplace(std::move(work));
-            _bell.notify_one();
+            if (wakeConsumer)
+            {
+                _bell.notify_one();
+            }
         }
 
         return ret;
@@ -92,9 +115,37 @@ template <class TaskType> class BufferedWorker
         }
     }
 
+    /**
+     * @brief Stop the worker after executing all pending tasks, regardless of
+     * the policy chosen on construction.
+     */
+    void drain()
+    {
+        _executeLeftoverTasks = true;
+        kill();
+    }
+
+    /**
+     * @brief Number of tasks waiting to run, readable without locking.
+     */
+    std::size_t pending() const
+    {
+        return _pending.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of tasks replaced by newer ones in a full queue.
+     */
+    std::uint64_t dropped() const
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
   private:
     void consume()
     {
+        detail::traceLabel() = "worker";
+
         while (!_stop)
         {
             swapBuffers();
@@ -121,13 +172,19 @@ template <class TaskType> class BufferedWorker
         {
             std::invoke(_front->front());
             _front->pop();
+            _pending.fetch_sub(1, std::memory_order_relaxed);
         }
     }
 
     void waitForDataOrStop()
     {
         std::unique_lock<std::mutex> lock(_mtx);
-        _bell.wait(lock, [this] { return _stop || !_back->empty(); });
+        while (!_stop && _back->empty())
+        {
+            _parked = true;
+            _bell.wait(lock);
+        }
+        _parked = false;
     }
 
   private:
@@ -137,8 +194,11 @@ template <class TaskType> class BufferedWorker
     mutable std::mutex _mtx;
     mutable std::condition_variable _bell;
     const std::size_t _maxLen;
+    bool _parked = false; // Guarded by _mtx.
     std::atomic_bool _stop;
-    const std::atomic_bool _executeLeftoverTasks;
+    std::atomic_bool _executeLeftoverTasks;
+    std::atomic_size_t _pending{0};
+    std::atomic<std::uint64_t> _dropped{0};
 };
 
 } // namespace ttt
@@ -0,0 +1,70 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <bitset>
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+namespace ttt
+{
+
+namespace detail
+{
+
+constexpr char kErrorCalendarExpression[] = "Invalid calendar expression";
+
+}
+
+/**
+ * @brief Wall clock times matching a cron-like expression, e.g. "0 2 * * *"
+ * for every day at 02:00 or "15,45 * * * 1" for :15 and :45 on Mondays.
+ *
+ * @details Expressions have five space separated fields:
+ *  minute (0-59) hour (0-23) day-of-month (1-31) month (1-12) weekday (0-7)
+ * Sunday is both 0 and 7. A field is a comma separated list of values, e.g.
+ * "5", ranges, e.g. "1-5", or "*" for all values. Ranges, values and "*" can
+ * be followed by a step, e.g. "8-18/2". As in cron, a day matches either day
+ * field when both are restricted.
+ * Expressions are compiled once to a bitset per field, so computing the next
+ * occurrence skips non matching months, days and hours, instead of stepping
+ * through every minute.
+ */
+class CalendarSchedule final
+{
+  public:
+    using time_point = std::chrono::sys_seconds;
+
+    /**
+     * @brief Compile a calendar expression.
+     *
+     * @param expression Fields of the schedule, as described above.
+     * @param utcOffset Offset of the time zone the expression refers to, e.g.
+     * +120min for a schedule in UTC+2. Defaults to UTC.
+     *
+     * @throw std::runtime_error if the expression is malformed.
+     */
+    explicit CalendarSchedule(std::string_view expression,
+                              std::chrono::minutes utcOffset = {});
+
+    /**
+     * @brief First time point matching the schedule, in a later minute than
+     * the given one. Empty if there is none, e.g. for "0 0 30 2 *".
+     */
+    std::optional<time_point> next(time_point after) const;
+
+  private:
+    bool matchesDay(std::chrono::year_month_day const &date) const;
+
+  private:
+    std::bitset<60> _minutes;
+    std::bitset<24> _hours;
+    std::bitset<32> _monthDays; // Bit 0 unused.
+    std::bitset<13> _months;    // Bit 0 unused.
+    std::bitset<7> _weekDays;   // Sunday is 0.
+    bool _anyMonthDay = false;
+    bool _anyWeekDay = false;
+    std::chrono::minutes _utcOffset;
+};
+
+} // namespace ttt
@@ -0,0 +1,139 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+
+namespace ttt
+{
+
+/**
+ * @brief A manually driven clock.
+ *
+ * @details Meets the requirements of a std::chrono clock, but time only moves
+ * forward when the user advances it. Schedulers that run on a VirtualClock
+ * are woken up on every advancement, so days of scheduled activity can be
+ * replayed in the time it takes to execute the tasks.
+ * The clock is process wide, like every std::chrono clock.
+ */
+class VirtualClock final
+{
+  public:
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<VirtualClock>;
+    static constexpr bool is_steady = true;
+
+    /**
+     * @brief RAII registration of a callback invoked after every advancement.
+     */
+    class Subscription
+    {
+        std::list<std::function<void()>>::iterator _it;
+        bool _active = false;
+
+      public:
+        Subscription() = default;
+        explicit Subscription(std::list<std::function<void()>>::iterator it);
+        Subscription(Subscription &&other) noexcept;
+        Subscription &operator=(Subscription &&other) noexcept;
+        ~Subscription();
+    };
+
+    /**
+     * @brief Current virtual time.
+     */
+    static time_point now() noexcept;
+
+    /**
+     * @brief Move time forward by the specified amount.
+     */
+    static void advance(duration d);
+
+    /**
+     * @brief Move time forward to the specified time point. Time points in the
+     * past leave the clock unchanged.
+     */
+    static void advanceTo(time_point tp);
+
+    /**
+     * @brief Register a callback to be invoked after every advancement.
+     */
+    [[nodiscard]] static Subscription subscribe(
+        std::function<void()> onAdvance);
+};
+
+namespace detail
+{
+
+/**
+ * @brief Clock specific operations needed by a scheduler.
+ *
+ * @details Clocks that tick on their own are waited upon with timed waits.
+ */
+template <class Clock> struct ClockTraits
+{
+    struct Subscription
+    {
+    };
+
+    static Subscription subscribe(std::function<void()>)
+    {
+        return {};
+    }
+
+    // Wall clock time at the clock's current time, for calendar schedules.
+    static std::chrono::system_clock::time_point wallNow()
+    {
+        return std::chrono::system_clock::now();
+    }
+
+    // Wait until the time point or the predicate is satisfied. Returns the
+    // predicate value. The predicate is evaluated once per wake up.
+    template <class CondVar, class Lock, class TimePoint, class Predicate>
+    static bool waitUntil(CondVar &cv, Lock &lock, TimePoint const &tp,
+                          Predicate pred)
+    {
+        return cv.wait_until(lock, tp, std::move(pred));
+    }
+};
+
+/**
+ * @brief Virtual time only moves on advancement, which notifies waiters.
+ */
+template <> struct ClockTraits<VirtualClock>
+{
+    using Subscription = VirtualClock::Subscription;
+
+    static Subscription subscribe(std::function<void()> onAdvance)
+    {
+        return VirtualClock::subscribe(std::move(onAdvance));
+    }
+
+    // Virtual time counts from the Unix epoch.
+    static std::chrono::system_clock::time_point wallNow()
+    {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                VirtualClock::now().time_since_epoch()));
+    }
+
+    template <class CondVar, class Lock, class TimePoint, class Predicate>
+    static bool waitUntil(CondVar &cv, Lock &lock, TimePoint const &tp,
+                          Predicate pred)
+    {
+        bool ret = false;
+        cv.wait(lock,
+                [&] { return (ret = pred()) || VirtualClock::now() >= tp; });
+        return ret;
+    }
+};
+
+} // namespace detail
+
+} // namespace ttt
@@ -0,0 +1,222 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ttt
+{
+
+/**
+ * @brief Load of a scheduler, as sampled by a monitor.
+ */
+struct SchedulerLoad
+{
+    SchedulerMetrics metrics;
+    // Rates since the previous sample.
+    double wakeupsPerSecond = 0;
+    double spuriousWakeupsPerSecond = 0;
+    // Fraction of executor time spent running tasks, since the previous
+    // sample. Tasks count when they finish.
+    double busyRatio = 0;
+};
+
+/**
+ * @brief Periodically samples the load of a scheduler and notifies rules
+ * whose condition holds for long enough, e.g. "overdue backlog > N for more
+ * than T ms", so that services can shed load or scale out.
+ *
+ * @details Sampling runs on a thread of the monitor, so that it is not held up
+ * by the overload it watches. Conditions and callbacks are invoked on that
+ * thread. The monitor has to be destroyed before the scheduler it watches.
+ *
+ * @tparam Scheduler Type of the monitored scheduler, e.g. CallScheduler.
+ */
+template <class Scheduler> class SchedulerMonitor final
+{
+  public:
+    using condition_t = std::function<bool(SchedulerLoad const &)>;
+    using callback_t = std::function<void(SchedulerLoad const &)>;
+
+    /**
+     * @brief Start monitoring a scheduler.
+     *
+     * @param scheduler Scheduler to sample.
+     * @param period Time between samples.
+     */
+    SchedulerMonitor(Scheduler const &scheduler,
+                     std::chrono::milliseconds period)
+        : _scheduler(scheduler), _period(period)
+    {
+        _sampler = std::thread(&SchedulerMonitor::run, this);
+    }
+
+    SchedulerMonitor(SchedulerMonitor const &) = delete;
+    SchedulerMonitor &operator=(SchedulerMonitor const &) = delete;
+
+    ~SchedulerMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _stop = true;
+        }
+        _bell.notify_one();
+        _sampler.join();
+    }
+
+    /**
+     * @brief Add a rule to evaluate on every sample.
+     *
+     * @param exceeded Condition of overload.
+     * @param sustained Time the condition has to hold before the rule fires.
+     * Zero fires on the first sample that meets the condition.
+     * @param onOverload Invoked once the condition has held long enough. Not
+     * invoked again until the condition has cleared.
+     * @param onRecovery Invoked on the first sample that clears the condition
+     * of a rule that fired. Optional.
+     */
+    void addRule(condition_t exceeded, std::chrono::milliseconds sustained,
+                 callback_t onOverload, callback_t onRecovery = {})
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _rules.push_back(Rule{.exceeded = std::move(exceeded),
+                              .sustained = sustained,
+                              .onOverload = std::move(onOverload),
+                              .onRecovery = std::move(onRecovery)});
+    }
+
+    /**
+     * @brief Most recent sample, empty before the first one.
+     */
+    std::optional<SchedulerLoad> latest() const
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _latest;
+    }
+
+  private:
+    struct Rule
+    {
+        condition_t exceeded;
+        std::chrono::milliseconds sustained;
+        callback_t onOverload;
+        callback_t onRecovery;
+        // Time the condition started holding, if it holds.
+        std::optional<std::chrono::steady_clock::time_point> since{};
+        bool fired = false;
+    };
+
+    void run()
+    {
+        using std::chrono::steady_clock;
+
+        auto previous = _scheduler.metrics();
+        auto previousTime = steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(_mtx);
+        while (!_bell.wait_for(lock, _period, [this] { return _stop; }))
+        {
+            lock.unlock();
+            auto const now = steady_clock::now();
+            auto const load = measure(previous, now - previousTime);
+            previous = load.metrics;
+            previousTime = now;
+            lock.lock();
+
+            _latest = load;
+            std::vector<callback_t> calls;
+            for (auto &rule : _rules)
+            {
+                if (auto call = evaluate(rule, load, now))
+                {
+                    calls.push_back(std::move(call));
+                }
+            }
+
+            lock.unlock();
+            for (auto const &call : calls)
+            {
+                call(load);
+            }
+            lock.lock();
+        }
+    }
+
+    SchedulerLoad measure(SchedulerMetrics const &previous,
+                          std::chrono::steady_clock::duration elapsed) const
+    {
+        SchedulerLoad ret{.metrics = _scheduler.metrics()};
+
+        auto const seconds = std::chrono::duration<double>(elapsed).count();
+        if (seconds > 0)
+        {
+            auto const &now = ret.metrics;
+            ret.wakeupsPerSecond = (now.wakeups - previous.wakeups) / seconds;
+            ret.spuriousWakeupsPerSecond =
+                (now.spuriousWakeups - previous.spuriousWakeups) / seconds;
+
+            if (auto const n = now.queueDepths.size(); n > 0)
+            {
+                auto const busy = std::chrono::duration<double>(
+                    now.busy - previous.busy);
+                ret.busyRatio =
+                    std::clamp(busy.count() / (seconds * n), 0.0, 1.0);
+            }
+        }
+
+        return ret;
+    }
+
+    // Returns the callback the sample triggers, if any.
+    static callback_t evaluate(Rule &rule, SchedulerLoad const &load,
+                               std::chrono::steady_clock::time_point now)
+    {
+        callback_t ret;
+
+        if (rule.exceeded(load))
+        {
+            if (!rule.since)
+            {
+                rule.since = now;
+            }
+            if (!rule.fired && now - *rule.since >= rule.sustained)
+            {
+                rule.fired = true;
+                ret = rule.onOverload;
+            }
+        }
+        else
+        {
+            if (rule.fired)
+            {
+                ret = rule.onRecovery;
+            }
+            rule.since.reset();
+            rule.fired = false;
+        }
+
+        return ret;
+    }
+
+  private:
+    Scheduler const &_scheduler;
+    std::chrono::milliseconds const _period;
+    mutable std::mutex _mtx;
+    std::condition_variable _bell;
+    bool _stop = false;                  // Guarded by _mtx.
+    std::vector<Rule> _rules;            // Guarded by _mtx.
+    std::optional<SchedulerLoad> _latest; // Guarded by _mtx.
+    // Declared last, so that it starts after everything it uses.
+    std::thread _sampler;
+};
+
+} // namespace ttt
@@ -0,0 +1,82 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include "scheduler.h"
+#include "timeline.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+namespace ttt
+{
+
+class TimelineStoreImpl;
+
+/**
+ * @brief Durable storage of a timeline, for crash recovery.
+ *
+ * @details Timers are persisted, other entities are not. Files kept in the
+ * store directory:
+ * - "timeline.snapshot" : binary image of all timers, memory mapped on load.
+ * - "timeline.journal.N": append-only records of the changes made after the
+ *   snapshot was taken.
+ * Changes are journaled as they happen, so steady state I/O is proportional
+ * to the number of changes rather than the number of timers. After a number
+ * of journal records, a new snapshot is written on a background thread and
+ * older journals are deleted. Timer ticks are not journaled: restored timers
+ * continue from the remaining time recorded on their last change.
+ * Durability: journal records are handed to the operating system as each
+ * change is made, so they survive a crash of the process. Only snapshots are
+ * synced to the storage device, hence a power loss can lose the changes
+ * journaled since the last compaction.
+ */
+class TimelineStore final
+{
+    std::unique_ptr<TimelineStoreImpl> _impl;
+
+  public:
+    /**
+     * @brief Open a store, restoring the timeline it contains.
+     *
+     * @param directory Location of the store files. Created if missing.
+     * @param timersEvent Callback that applies to timer events.
+     * @param scheduler Scheduler to run entities on. If null, the timeline
+     * creates a private scheduler.
+     * @param compactAfter Number of journal records that triggers compaction.
+     *
+     * @throw std::runtime_error if the store files cannot be read or written.
+     */
+    explicit TimelineStore(
+        std::filesystem::path const &directory,
+        std::function<void(TimerState const &)> timersEvent,
+        std::shared_ptr<CallScheduler> scheduler = nullptr,
+        std::size_t compactAfter = 4096);
+    /**
+     * @brief Destructor defined out of line, because of incomplete types.
+     */
+    ~TimelineStore();
+
+    /**
+     * @brief The persisted timeline. Changes made through it are journaled,
+     * regardless of the timers observer set on it.
+     */
+    Timeline &timeline();
+
+    /**
+     * @brief Whether all changes made so far are persisted. Failing to write a
+     * journal record does not fail the timeline operation that made the
+     * change: journaling stops and the store reports unhealthy, until a
+     * compaction persists the timeline anew.
+     */
+    bool healthy() const;
+
+    /**
+     * @brief Write a snapshot of the timeline and drop the journals it
+     * covers. Runs automatically once enough changes are journaled.
+     */
+    void compact();
+};
+
+} // namespace ttt
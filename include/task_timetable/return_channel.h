@@ -0,0 +1,101 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace ttt
+{
+
+namespace detail
+{
+
+/**
+ * @brief Lock-free channel from many producers to a single consumer.
+ *
+ * @details Producers push onto an intrusive stack with a single compare and
+ * swap, linking items through a member of their own, i.e. without allocating.
+ * The consumer takes the whole stack with one exchange and visits it in push
+ * order, so that there is no contention between consumer and producers
+ * beyond that exchange, and no ABA hazard since nodes are never popped one by
+ * one. Push and the emptiness check are sequentially consistent, allowing
+ * parties to pair them with flags of their own, e.g. to decide whether a
+ * consumer about to sleep has to be woken.
+ *
+ * @tparam Node Type of the transferred items, owned through unique pointers
+ * and having a "Node *next" member for the channel to use.
+ */
+template <class Node> class ReturnChannel final
+{
+  public:
+    ReturnChannel() = default;
+
+    ReturnChannel(ReturnChannel const &) = delete;
+    ReturnChannel &operator=(ReturnChannel const &) = delete;
+
+    ~ReturnChannel()
+    {
+        consume([](std::unique_ptr<Node> &&) {});
+    }
+
+    /**
+     * @brief Add an item. Callable from any thread.
+     */
+    void push(std::unique_ptr<Node> item)
+    {
+        auto node = item.release();
+        node->next = _head.load();
+        while (!_head.compare_exchange_weak(node->next, node))
+        {
+        }
+    }
+
+    bool empty() const
+    {
+        return nullptr == _head.load();
+    }
+
+    /**
+     * @brief Hand the items pushed so far to a function, oldest first. Only
+     * callable by a single thread at a time.
+     *
+     * @return Number of items consumed.
+     */
+    template <class F> std::size_t consume(F &&fun)
+    {
+        std::size_t ret = 0;
+        if (empty())
+        {
+            return ret; // Leave the cache line shared with producers.
+        }
+
+        // Reverse the stack, to visit items in push order.
+        Node *ordered = nullptr;
+        for (auto node = _head.exchange(nullptr); node;)
+        {
+            auto next = node->next;
+            node->next = ordered;
+            ordered = node;
+            node = next;
+        }
+
+        while (ordered)
+        {
+            std::unique_ptr<Node> node(ordered);
+            ordered = node->next;
+            node->next = nullptr;
+            fun(std::move(node));
+            ++ret;
+        }
+
+        return ret;
+    }
+
+  private:
+    std::atomic<Node *> _head{nullptr};
+};
+
+} // namespace detail
+
+} // namespace ttt
@@ -2,46 +2,355 @@
 #pragma once
 
 #include "buffered_worker.h"
+#include "calendar.h"
+#include "clock.h"
+#include "return_channel.h"
+#include "task_queue.h"
+#include "tracer.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <concepts>
 #include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <map>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace ttt
 {
 
+namespace detail
+{
+
+/**
+ * @brief Object whose address identifies a clock type.
+ */
+template <class Clock> inline constexpr char kClockTag = 0;
+
+} // namespace detail
+
 /**
  * @brief Designates the result of a call++ task, i.e. whether it is to be
  * repeated or the execution was the last one.
+ *
+ * @details Besides repeating on their interval, tasks can choose when they
+ * run next, e.g. to back off while idle, without being re-added:
+ * - Result::repeatAfter(delay): run again after the delay, counted from the
+ *   end of this execution.
+ * - Result::repeatAt(timePoint): run again at a time point, preferably of the
+ *   scheduler's clock. Time points of other clocks, e.g. system_clock on a
+ *   steady_clock scheduler, are converted through the delay they represent
+ *   when the result is created.
+ * The choice only applies to the next execution, later ones return to the
+ * interval unless the task chooses again.
+ */
+class Result
+{
+  public:
+    enum Kind : std::uint8_t
+    {
+        Finished,
+        Repeat,
+        RepeatAfter,
+        RepeatAt
+    };
+
+    constexpr Result(Kind kind = Finished) noexcept : _kind(kind)
+    {
+    }
+
+    /**
+     * @brief Repeat after the specified delay, instead of the interval.
+     */
+    static constexpr Result repeatAfter(std::chrono::microseconds delay)
+    {
+        Result ret(RepeatAfter);
+        ret._value = delay;
+        return ret;
+    }
+
+    /**
+     * @brief Repeat at the specified time point. The result remembers the
+     * clock of the time point, along with its distance from that clock's
+     * present, to convert it for schedulers of a different clock.
+     */
+    template <class Clock, class Duration>
+    static Result repeatAt(std::chrono::time_point<Clock, Duration> timePoint)
+    {
+        Result ret(RepeatAt);
+        ret._value = std::chrono::ceil<std::chrono::microseconds>(
+            timePoint.time_since_epoch());
+        ret._delay = std::chrono::ceil<std::chrono::microseconds>(
+            timePoint - Clock::now());
+        ret._clock = &detail::kClockTag<Clock>;
+        return ret;
+    }
+
+    constexpr Kind kind() const noexcept
+    {
+        return _kind;
+    }
+
+    /**
+     * @brief Delay of RepeatAfter, or time since the clock's epoch of
+     * RepeatAt results.
+     */
+    constexpr std::chrono::microseconds value() const noexcept
+    {
+        return _value;
+    }
+
+    /**
+     * @brief Time point of a RepeatAt result on the specified clock.
+     */
+    template <class Clock>
+    std::chrono::time_point<Clock, std::chrono::microseconds> at() const
+    {
+        using time_point_t =
+            std::chrono::time_point<Clock, std::chrono::microseconds>;
+
+        if (&detail::kClockTag<Clock> == _clock)
+        {
+            return time_point_t(_value);
+        }
+        return std::chrono::ceil<std::chrono::microseconds>(Clock::now()) +
+               _delay;
+    }
+
+    friend constexpr bool operator==(Result const &lhs,
+                                     Result const &rhs) noexcept
+    {
+        return lhs._kind == rhs._kind && lhs._value == rhs._value &&
+               lhs._clock == rhs._clock;
+    }
+
+  private:
+    Kind _kind;
+    std::chrono::microseconds _value{0};
+    std::chrono::microseconds _delay{0}; // RepeatAt time point minus now().
+    void const *_clock = nullptr;        // Clock of RepeatAt time points.
+};
+
+/**
+ * @brief Identifies an execution lane of a scheduler.
+ */
+using LaneId = std::uint32_t;
+
+/**
+ * @brief Lane created along with every scheduler.
+ */
+inline constexpr LaneId kDefaultLane = 0;
+
+/**
+ * @brief Placement of an added task.
+ */
+struct TaskOptions
+{
+    bool immediate = false;     // Queue the task for execution right away.
+    LaneId lane = kDefaultLane; // Executors that run the task.
+};
+
+/**
+ * @brief Token bucket limiting the rate at which a lane starts tasks.
+ *
+ * @details A token is earned every interval, up to "burst" tokens. Tasks that
+ * come due without a token available are deferred to the time their token is
+ * earned, instead of occupying an executor.
+ */
+struct RateLimit
+{
+    std::chrono::microseconds interval{0}; // Inverse of the sustained rate.
+    std::size_t burst = 1;                 // Tasks starting back to back.
+};
+
+/**
+ * @brief Counters of the tasks that ran on a lane.
+ */
+struct LaneStats
+{
+    std::string name;
+    std::size_t workers = 0;
+    std::uint64_t runs = 0;     // Task executions.
+    std::uint64_t deferred = 0; // Task executions delayed by the rate limit.
+    // Time between a task being due and starting to run, summed over all
+    // executions and its maximum.
+    std::chrono::microseconds totalDelay{0};
+    std::chrono::microseconds maxDelay{0};
+    // Time spent running tasks.
+    std::chrono::microseconds busy{0};
+};
+
+/**
+ * @brief Point in time load counters of a scheduler.
  */
-enum class Result : uint8_t
+struct SchedulerMetrics
 {
-    Finished,
-    Repeat
+    // Tasks queued on each executor, lanes in order of creation.
+    std::vector<std::size_t> queueDepths;
+    // Tasks past their due time, waiting for the coordinator.
+    std::size_t overdue = 0;
+    // Times the coordinator woke up, in total and without finding a task due
+    // or an earlier deadline to wait for.
+    std::uint64_t wakeups = 0;
+    std::uint64_t spuriousWakeups = 0;
+    // Time executors spent running tasks, summed over all of them.
+    std::chrono::microseconds busy{0};
+    // Tasks dropped by full executor queues.
+    std::uint64_t dropped = 0;
 };
 
 namespace detail
 {
 
 constexpr char kErrorNoWorkersInScheduler[] = "Scheduler has NO workers";
+constexpr char kErrorNotEmbedded[] = "Scheduler runs tasks on its own threads";
+constexpr char kErrorEmbeddedLanes[] = "Embedded scheduler runs tasks inline";
+constexpr char kErrorLaneExists[] = "Lane name is already in use";
+constexpr char kErrorUnknownLane[] = "Scheduler has no such lane";
+constexpr char kErrorInvalidRate[] = "Rate limit needs an interval and burst";
+
+class CallTokenImpl
+{
+    // Potential states of a token.
+    static constexpr int kIdle = 0;
+    static constexpr int kRunning = 1;
+    static constexpr int kDead = 2;
+
+  public:
+    // Returns the token to idle on destruction, if it was allowed to run.
+    class StateReset
+    {
+        std::atomic_int *_state;
+
+      public:
+        explicit StateReset(std::atomic_int *state = nullptr) : _state(state)
+        {
+        }
+
+        StateReset(StateReset const &) = delete;
+        StateReset &operator=(StateReset const &) = delete;
+
+        ~StateReset()
+        {
+            if (_state)
+            {
+                *_state = kIdle;
+            }
+        }
+
+        explicit operator bool() const
+        {
+            return nullptr != _state;
+        }
+    };
+
+    [[nodiscard]] StateReset allow()
+    {
+        int expected = kIdle;
+        return StateReset(_state.compare_exchange_strong(expected, kRunning)
+                              ? &_state
+                              : nullptr);
+    }
+
+    void cancel()
+    {
+        int expected = kIdle;
+        while (!_state.compare_exchange_strong(expected, kDead) &&
+               kDead != expected)
+        {
+            expected = kIdle;
+        }
+    }
+
+  private:
+    std::atomic_int _state{kIdle};
+};
 
-class CallTokenImpl;
+// Tasks of a group belong to the generation current at their addition, and
+// are cancelled by moving the group to the next one.
+struct TaskGroupImpl
+{
+    std::atomic<std::uint64_t> generation{0};
+};
 
-struct Task
+template <class Callable> struct Task
 {
-    std::function<Result()> work;
-    std::shared_ptr<CallTokenImpl> pass;
+    Callable work;
+    std::shared_ptr<CallTokenImpl> pass{}; // Null for tasks of a group.
     std::chrono::microseconds interval;
+    LaneId lane = kDefaultLane;
+    std::shared_ptr<TaskGroupImpl> group{};
+    std::uint64_t generation = 0;
+    bool admitted = false; // Deferred, holding a token of its lane's limit.
+    // Calendar of tasks that repeat at wall clock times instead of intervals,
+    // and the occurrence the task is due at.
+    std::shared_ptr<CalendarSchedule const> calendar{};
+    CalendarSchedule::time_point occurrence{};
+
+    bool cancelled() const
+    {
+        return group &&
+               generation != group->generation.load(std::memory_order_acquire);
+    }
+
+    // Identifies the task in traces. Stable, since scheduler nodes are moved
+    // around as a whole.
+    std::uint64_t traceId() const
+    {
+        return reinterpret_cast<std::uintptr_t>(this);
+    }
 };
 
 } // namespace detail
 
+/**
+ * @brief Tag type selecting the thread-free mode of a scheduler.
+ */
+struct Embedded
+{
+    explicit Embedded() = default;
+};
+
+inline constexpr Embedded kEmbedded{};
+
+/**
+ * @brief Requirements of the executor policy of schedulers, met by
+ * BufferedWorker and WorkerGroup.
+ *
+ * @details Executors are default constructed, run the tasks added to them,
+ * run everything queued when drained, and report their queue length and the
+ * tasks they dropped.
+ */
+template <class E, class Task>
+concept TaskExecutor =
+    std::default_initializable<E> &&
+    requires(E e, E const ce, Task task) {
+        e.add(std::move(task));
+        e.drain();
+        { ce.pending() } -> std::convertible_to<std::size_t>;
+        { ce.dropped() } -> std::convertible_to<std::uint64_t>;
+    };
+
+template <class Clock,
+          template <class, class> class Queue = OrderedTaskQueue,
+          class Callable = std::function<Result()>,
+          template <class> class Executor = BufferedWorker,
+          class Lock = std::mutex>
+class BasicCallScheduler;
+
 /**
  * @brief Controls the execution of a Callscheduler task.
  *
@@ -74,6 +383,43 @@ class CallToken
     void detach();
 };
 
+/**
+ * @brief Cancels many scheduler tasks at once, e.g. the timers of a connection
+ * being torn down.
+ *
+ * @details Tasks added under a group are not controlled by tokens. Cancelling
+ * the group is a single atomic increment, regardless of the number of tasks:
+ * cancelled tasks are dropped when they come due, without running. Tasks that
+ * are already running finish, but are not repeated. Tasks added after a
+ * cancellation belong to the group anew. Destroying the group cancels its
+ * tasks.
+ */
+class TaskGroup
+{
+    template <class Clock, template <class, class> class Queue,
+              class Callable, template <class> class Executor, class Lock>
+    friend class BasicCallScheduler;
+
+    std::shared_ptr<detail::TaskGroupImpl> _impl;
+
+  public:
+    TaskGroup();
+
+    TaskGroup(TaskGroup const &) = delete;
+    TaskGroup &operator=(TaskGroup const &) = delete;
+    TaskGroup(TaskGroup &&) = default;
+
+    /**
+     * @brief Cancels the tasks of the group, unless moved from.
+     */
+    ~TaskGroup();
+
+    /**
+     * @brief Cancel all tasks added to the group so far.
+     */
+    void cancel();
+};
+
 /**
  * @brief Central class of the task timetable library.
  *
@@ -82,26 +428,141 @@ class CallToken
  * - A single coordinator thread which picks "due to run" tasks.
  * - An executor thread pool where tasks actually run.
  * Decomposition in two parts is done so that scheduling is not slowed down by
- * task processing.
+ * task processing. Executors return repeating tasks to the coordinator over
+ * a lock-free channel, and only wake it if a task is due before the
+ * coordinator's own wake up time.
+ * Executors are organized in lanes, i.e. isolated groups with their own
+ * queues, so that slow tasks do not delay the ones placed on other lanes.
+ * Tasks run on the default lane unless placed otherwise.
  * A scheduler drops all unfinished tasks upon destruction, since repeating
- * tasks would prevent destruction otherwise.
+ * tasks would prevent destruction otherwise. Use shutdown() to flush the tasks
+ * that are due within a time window before stopping.
+ * Schedulers constructed in embedded mode spawn no threads. Instead, the host
+ * (e.g. an event loop) queries the next deadline and runs due tasks inline.
+ *
+ * Besides the clock, the parts of the scheduler are compile time policies,
+ * so that services can trade generality for speed without virtual dispatch.
+ *
+ * @tparam Clock Time source of the scheduler, e.g. std::chrono::steady_clock
+ * or ttt::VirtualClock for deterministic, fast-forwarded execution.
+ * @tparam Queue Container of pending tasks, satisfying TaskQueue, e.g.
+ * OrderedTaskQueue or HeapTaskQueue.
+ * @tparam Callable Type of the tasks, invocable without arguments and
+ * returning a Result, e.g. a function pointer to avoid type erasure.
+ * @tparam Executor Worker template that runs tasks, satisfying TaskExecutor,
+ * e.g. BufferedWorker or WorkerGroup.
+ * @tparam Lock Mutex guarding the scheduler, e.g. ttt::SpinLock where the
+ * lock is only held briefly.
  */
-class CallScheduler final
+template <class Clock, template <class, class> class Queue, class Callable,
+          template <class> class Executor, class Lock>
+class BasicCallScheduler final
 {
-    using execution_time_point_t = std::chrono::steady_clock::time_point;
-    using task_map_t = std::multimap<execution_time_point_t, detail::Task>;
+    using clock_traits_t = detail::ClockTraits<Clock>;
+    using execution_time_point_t = std::chrono::time_point<
+        Clock, std::common_type_t<typename Clock::duration,
+                                  std::chrono::microseconds>>;
+    using task_t = detail::Task<Callable>;
+    using task_map_t = Queue<execution_time_point_t, task_t>;
+    using node_t = typename task_map_t::node_type;
+    using node_ptr_t = std::unique_ptr<node_t>;
+    using condition_t =
+        std::conditional_t<std::is_same_v<Lock, std::mutex>,
+                           std::condition_variable,
+                           std::condition_variable_any>;
+
+    struct Lane;
 
     class TaskRunner
     {
-        CallScheduler &_parent;
-        task_map_t::node_type _node;
+        BasicCallScheduler &_parent;
+        Lane &_lane;
+        node_ptr_t _node;
 
       public:
-        TaskRunner(CallScheduler &parent, task_map_t::node_type &&node);
-        void operator()();
+        TaskRunner(BasicCallScheduler &parent, Lane &lane, node_ptr_t node)
+            : _parent(parent), _lane(lane), _node(std::move(node))
+        {
+        }
+
+        void operator()()
+        {
+            Result outcome{Result::Finished};
+            auto &task = _node->task;
+            bool ran = false;
+
+            if (!task.cancelled())
+            {
+                auto const reset = task.pass
+                                       ? task.pass->allow()
+                                       : detail::CallTokenImpl::StateReset();
+                if (reset || !task.pass)
+                {
+                    ran = true;
+                    detail::trace('B', "run", task.traceId(), task.lane);
+                    auto const start = Clock::now();
+                    outcome = task.work();
+                    _lane.record(start - _node->due, Clock::now() - start);
+                    detail::trace('E', "run", task.traceId(), task.lane);
+                }
+            }
+            if (!ran)
+            {
+                detail::trace('i', "skip", task.traceId());
+            }
+
+            if (Result::Finished != outcome.kind() && !task.cancelled())
+            {
+                if (Result::RepeatAfter == outcome.kind())
+                {
+                    _node->due = Clock::now() + outcome.value();
+                }
+                else if (Result::RepeatAt == outcome.kind())
+                {
+                    _node->due = time_point_t(
+                        std::chrono::duration_cast<
+                            typename time_point_t::duration>(
+                            outcome.template at<Clock>().time_since_epoch()));
+                }
+                else if (!task.calendar)
+                {
+                    _node->due = (_parent._countOnTaskStart ? _node->due
+                                                            : Clock::now()) +
+                                 task.interval;
+                }
+                else if (auto const due = nextOccurrence(task))
+                {
+                    _node->due = *due;
+                }
+                else
+                {
+                    return; // No further occurrences.
+                }
+
+                detail::trace('i', "rearm", task.traceId(),
+                              micros(_node->due - Clock::now()));
+                if (!_lane.executors.empty())
+                {
+                    _parent.rearm(std::move(_node));
+                    return;
+                }
+
+                // Running inline, i.e. embedded.
+                std::lock_guard<Lock> lock(_parent._scheduler.mtx);
+                if (!_parent._draining) // No re-arming during shutdown.
+                {
+                    _parent._tasks.push(std::move(_node));
+                }
+            }
+        }
     };
 
+    static_assert(TaskQueue<task_map_t>);
+    static_assert(TaskExecutor<Executor<TaskRunner>, TaskRunner>);
+
   public:
+    using time_point_t = execution_time_point_t;
+
     /**
      * @brief Create a call scheduler.
      *
@@ -112,45 +573,863 @@ class CallScheduler final
      * @param nExecutors Number of workers that execute tasks. Values beyond
      * hardware concurrency will be truncated.
      */
-    explicit CallScheduler(bool countIntervalOnTaskStart = true,
-                           unsigned nExecutors = 1);
+    explicit BasicCallScheduler(bool countIntervalOnTaskStart = true,
+                                unsigned nExecutors = 1)
+        : _countOnTaskStart(countIntervalOnTaskStart), _embedded(false)
+    {
+        if (0 == nExecutors)
+        {
+            throw std::runtime_error(detail::kErrorNoWorkersInScheduler);
+        }
+        _lanes.emplace_back(
+            "default",
+            std::min(nExecutors, std::thread::hardware_concurrency()));
+
+        _clockSubscription = clock_traits_t::subscribe([this] {
+            {
+                std::lock_guard<Lock> lock(_scheduler.mtx);
+            }
+            _scheduler.cv.notify_one();
+        });
+        _scheduler.consumer = std::thread(&BasicCallScheduler::run, this);
+    }
+
+    /**
+     * @brief Create a call scheduler that spawns no threads. Tasks run on the
+     * thread calling runDue().
+     *
+     * @param countIntervalOnTaskStart Same as in the threaded mode.
+     */
+    explicit BasicCallScheduler(Embedded, bool countIntervalOnTaskStart = true)
+        : _countOnTaskStart(countIntervalOnTaskStart), _embedded(true)
+    {
+        _lanes.emplace_back("default", 0);
+    }
+
+    ~BasicCallScheduler()
+    {
+        stopCoordinator();
+
+        // Explicit so that access to destroyed tasks is prevented.
+        _lanes.clear();
+    }
+
+    /**
+     * @brief Create an execution lane, i.e. a group of executors with their
+     * own queues, that only runs the tasks placed on it.
+     *
+     * @param name Lane description, unique within the scheduler.
+     * @param nExecutors Number of workers of the lane. Values beyond hardware
+     * concurrency will be truncated.
+     *
+     * @return Identifier used to place tasks on the lane.
+     *
+     * @throw std::runtime_error if the name is taken, the scheduler is
+     * embedded or no executors are requested.
+     */
+    LaneId addLane(std::string name, unsigned nExecutors = 1)
+    {
+        if (0 == nExecutors)
+        {
+            throw std::runtime_error(detail::kErrorNoWorkersInScheduler);
+        }
+
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        if (_embedded)
+        {
+            throw std::runtime_error(detail::kErrorEmbeddedLanes);
+        }
+        if (findLaneLocked(name))
+        {
+            throw std::runtime_error(detail::kErrorLaneExists);
+        }
+
+        _lanes.emplace_back(
+            std::move(name),
+            std::min(nExecutors, std::thread::hardware_concurrency()));
+        return static_cast<LaneId>(_lanes.size() - 1);
+    }
+
+    /**
+     * @brief Limit the rate at which a lane starts tasks. Applies to tasks
+     * coming due after the call; shutdown() ignores limits.
+     *
+     * @param lane Lane to limit.
+     * @param limit Token bucket of the lane. Empty to remove the limit.
+     *
+     * @throw std::runtime_error if the lane does not exist, the limit has a
+     * zero interval or burst, or the scheduler is embedded.
+     */
+    void setLaneLimit(LaneId lane, std::optional<RateLimit> limit)
+    {
+        if (limit && (limit->interval <= std::chrono::microseconds(0) ||
+                      0 == limit->burst))
+        {
+            throw std::runtime_error(detail::kErrorInvalidRate);
+        }
+
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        if (_embedded)
+        {
+            throw std::runtime_error(detail::kErrorEmbeddedLanes);
+        }
+        checkLane(lane);
+
+        _lanes[lane].limit = limit;
+        _lanes[lane].earned = {};
+    }
+
+    /**
+     * @brief Identifier of the lane with the given name, if any.
+     */
+    std::optional<LaneId> findLane(std::string_view name) const
+    {
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        return findLaneLocked(name);
+    }
 
-    ~CallScheduler();
+    /**
+     * @brief Whether tasks can be placed on the given lane.
+     */
+    bool hasLane(LaneId lane) const
+    {
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        return lane < _lanes.size();
+    }
+
+    /**
+     * @brief Current load of the scheduler. Meant for periodic sampling,
+     * e.g. by a SchedulerMonitor: counting overdue tasks takes the scheduler
+     * lock for a time proportional to their number.
+     */
+    SchedulerMetrics metrics() const
+    {
+        SchedulerMetrics ret;
+
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        ret.overdue = _tasks.countUntil(Clock::now());
+
+        ret.wakeups = _wakeups;
+        ret.spuriousWakeups = _spuriousWakeups;
+        for (auto const &lane : _lanes)
+        {
+            ret.busy += lane.stats().busy;
+            for (auto const &executor : lane.executors)
+            {
+                ret.queueDepths.push_back(executor.pending());
+                ret.dropped += executor.dropped();
+            }
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Counters of the tasks that ran on a lane, if the lane exists.
+     * Values are updated as tasks finish, hence are not a consistent snapshot
+     * while tasks run.
+     */
+    std::optional<LaneStats> laneStats(LaneId lane) const
+    {
+        std::optional<LaneStats> ret;
+
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        if (lane < _lanes.size())
+        {
+            ret.emplace(_lanes[lane].stats());
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Stop the scheduler without losing the tasks that are due until
+     * the specified deadline.
+     *
+     * @details After shutdown begins:
+     * - New tasks are not accepted, i.e. add() returns tokens of tasks that
+     *   never run.
+     * - Repeating tasks are not re-armed.
+     * - Executors run everything in their queues.
+     * - Tasks due until the deadline then run on the calling thread, in due
+     *   order, since executor queues are bounded and would drop the oldest
+     *   tasks of a large backlog.
+     * - Tasks due after the deadline are dropped.
+     * The call blocks until the due tasks have run and has no effect on
+     * schedulers that are already shut down.
+     *
+     * @param drainUntil Deadline of the tasks to flush.
+     */
+    void shutdown(time_point_t drainUntil)
+    {
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            if (_draining)
+            {
+                return;
+            }
+            _draining = true;
+        }
+        stopCoordinator();
+
+        std::vector<node_ptr_t> due;
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            collectRearms();
+            while (!_tasks.empty() && _tasks.top().due <= drainUntil)
+            {
+                due.push_back(_tasks.pop());
+            }
+            _tasks.clear();
+        }
+
+        for (auto &lane : _lanes)
+        {
+            for (auto &executor : lane.executors)
+            {
+                executor.drain();
+            }
+        }
+
+        for (auto &node : due)
+        {
+            auto &lane = _lanes[node->task.lane];
+            TaskRunner(*this, lane, std::move(node))();
+        }
+    }
 
     /**
      * @brief Add a new task to the scheduler.
      *
-     * @param call Task to be executed by the scheduler. The return value is a
-     * Result enumerator denoting whether to repeat the task or drop it.
+     * @param call Task to be executed by the scheduler. The returned Result
+     * denotes whether to drop the task or when to repeat it.
      * @param interval Timeout until repeating the execution of a task (if
      * applicable).
      * @param immediate If true the task is immediately scheduled for execution.
      *
      * @return Calltoken object controlling the lifetime of the added task.
      */
-    [[nodiscard]] CallToken add(std::function<Result()> call,
+    [[nodiscard]] CallToken add(Callable call,
+                                std::chrono::microseconds interval,
+                                bool immediate = false)
+    {
+        return addAfter(std::move(call),
+                        immediate ? std::chrono::microseconds(0) : interval,
+                        interval);
+    }
+
+    /**
+     * @brief Add a new task to the scheduler, placed on a lane.
+     *
+     * @param call Task to be executed by the scheduler, as in add().
+     * @param interval Timeout until repeating the execution of a task (if
+     * applicable).
+     * @param options Whether to schedule immediately and the lane to run on.
+     *
+     * @return Calltoken object controlling the lifetime of the added task.
+     *
+     * @throw std::runtime_error if the lane does not exist.
+     */
+    [[nodiscard]] CallToken add(Callable call,
                                 std::chrono::microseconds interval,
-                                bool immediate = false);
+                                TaskOptions options)
+    {
+        return addAfter(
+            std::move(call),
+            options.immediate ? std::chrono::microseconds(0) : interval,
+            interval, options.lane);
+    }
+
+    /**
+     * @brief Add a new task, controlled by a group instead of a token.
+     *
+     * @param group Group whose cancellation also cancels the task.
+     * @param call Task to be executed by the scheduler, as in add().
+     * @param interval Timeout until repeating the execution of a task (if
+     * applicable).
+     * @param options Whether to schedule immediately and the lane to run on.
+     *
+     * @throw std::runtime_error if the lane does not exist.
+     */
+    void add(TaskGroup const &group, Callable call,
+             std::chrono::microseconds interval, TaskOptions options = {})
+    {
+        auto const &state = group._impl;
+        auto const delay =
+            options.immediate ? std::chrono::microseconds(0) : interval;
+        task_t task{
+            .work = std::move(call),
+            .interval = interval,
+            .lane = options.lane,
+            .group = state,
+            .generation = state->generation.load(std::memory_order_acquire)};
+
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            checkLane(options.lane);
+            if (_draining)
+            {
+                return; // Not accepting tasks.
+            }
+            enqueue(Clock::now() + delay, std::move(task));
+        }
+        _scheduler.cv.notify_one();
+    }
+
+    /**
+     * @brief Add a task that runs at the wall clock times of a calendar
+     * schedule, e.g. every day at 02:00. The next occurrence is computed when
+     * the task is re-armed, so the scheduler sleeps until it is due instead
+     * of polling. Occurrences missed while the task ran are skipped.
+     *
+     * @param schedule Times to run the task at.
+     * @param call Task to be executed by the scheduler, as in add().
+     * @param lane Executors that run the task.
+     *
+     * @return Calltoken object controlling the lifetime of the added task.
+     *
+     * @throw std::runtime_error if the lane does not exist.
+     */
+    [[nodiscard]] CallToken add(CalendarSchedule schedule,
+                                Callable call,
+                                LaneId lane = kDefaultLane)
+    {
+        auto token{std::make_shared<detail::CallTokenImpl>()};
+
+        task_t task{
+            .work = std::move(call),
+            .pass = token,
+            .interval = std::chrono::microseconds(0),
+            .lane = lane,
+            .calendar =
+                std::make_shared<CalendarSchedule const>(std::move(schedule))};
+        auto const due = nextOccurrence(task);
+
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            checkLane(lane);
+            if (_draining || !due)
+            {
+                return CallToken(token); // Not accepting tasks or never due.
+            }
+            enqueue(*due, std::move(task));
+        }
+        _scheduler.cv.notify_one();
+
+        return CallToken(token);
+    }
+
+    /**
+     * @brief Add a new task whose first execution is not a full interval
+     * away, e.g. a countdown resumed halfway.
+     *
+     * @param call Task to be executed by the scheduler, as in add().
+     * @param delay Timeout until the first execution of the task.
+     * @param interval Timeout until repeating the execution of a task (if
+     * applicable).
+     * @param lane Executors that run the task.
+     *
+     * @return Calltoken object controlling the lifetime of the added task.
+     *
+     * @throw std::runtime_error if the lane does not exist.
+     */
+    [[nodiscard]] CallToken addAfter(Callable call,
+                                     std::chrono::microseconds delay,
+                                     std::chrono::microseconds interval,
+                                     LaneId lane = kDefaultLane)
+    {
+        auto token{std::make_shared<detail::CallTokenImpl>()};
+
+        task_t task{.work = std::move(call),
+                          .pass = token,
+                          .interval = interval,
+                          .lane = lane};
+
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            checkLane(lane);
+            if (_draining)
+            {
+                return CallToken(token); // Not accepting tasks.
+            }
+            enqueue(Clock::now() + delay, std::move(task));
+        }
+        _scheduler.cv.notify_one();
+
+        return CallToken(token);
+    }
+
+    /**
+     * @brief Add many tasks under a single lock acquisition.
+     *
+     * @param calls Tasks paired with the interval of each.
+     * @param immediate If true the tasks are immediately scheduled for
+     * execution.
+     *
+     * @return Calltoken objects controlling the lifetime of the added tasks,
+     * in the order of the input.
+     */
+    [[nodiscard]] std::vector<CallToken> add(
+        std::vector<std::pair<Callable, std::chrono::microseconds>> calls,
+        bool immediate = false)
+    {
+        return add(std::move(calls), TaskOptions{.immediate = immediate});
+    }
+
+    /**
+     * @brief Add many tasks, placed on the same lane, under a single lock
+     * acquisition.
+     *
+     * @param calls Tasks paired with the interval of each.
+     * @param options Whether to schedule immediately and the lane to run on.
+     *
+     * @return Calltoken objects controlling the lifetime of the added tasks,
+     * in the order of the input.
+     *
+     * @throw std::runtime_error if the lane does not exist.
+     */
+    [[nodiscard]] std::vector<CallToken> add(
+        std::vector<std::pair<Callable, std::chrono::microseconds>> calls,
+        TaskOptions options)
+    {
+        std::vector<CallToken> ret;
+        ret.reserve(calls.size());
+
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            checkLane(options.lane);
+            auto const now = Clock::now();
+
+            for (auto &[call, interval] : calls)
+            {
+                auto token{std::make_shared<detail::CallTokenImpl>()};
+                if (!_draining)
+                {
+                    enqueue(options.immediate ? now : now + interval,
+                            task_t{.work = std::move(call),
+                                   .pass = token,
+                                   .interval = interval,
+                                   .lane = options.lane});
+                }
+                ret.emplace_back(std::move(token));
+            }
+        }
+        _scheduler.cv.notify_one();
+
+        return ret;
+    }
+
+    /**
+     * @brief Time point of the earliest scheduled task, if any. Embedded
+     * schedulers are re-queried after adding tasks, since there is no thread
+     * to wake up.
+     */
+    std::optional<time_point_t> nextDeadline() const
+    {
+        std::optional<time_point_t> ret;
+
+        std::lock_guard<Lock> lock(_scheduler.mtx);
+        if (!_tasks.empty())
+        {
+            ret = _tasks.top().due;
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Run, on the calling thread, the tasks that are due at the given
+     * time point. Tasks re-armed to a time point not later than "now" will run
+     * on the next invocation. Only available in embedded mode and meant to be
+     * called from a single thread.
+     *
+     * @param now Time point to compare deadlines against.
+     *
+     * @return Number of due tasks that were processed.
+     */
+    std::size_t runDue(time_point_t now)
+    {
+        if (!_embedded)
+        {
+            throw std::runtime_error(detail::kErrorNotEmbedded);
+        }
+
+        std::vector<node_ptr_t> due;
+        due.swap(_due);
+
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            while (!_tasks.empty() && _tasks.top().due <= now)
+            {
+                due.push_back(_tasks.pop());
+            }
+        }
+
+        auto const ret = due.size();
+        for (auto &node : due)
+        {
+            TaskRunner(*this, _lanes.front(), std::move(node))();
+        }
+        due.clear();
+        _due.swap(due);
+
+        return ret;
+    }
+
+    /**
+     * @brief Run, on the calling thread, the tasks that are currently due.
+     */
+    std::size_t runDue()
+    {
+        return runDue(Clock::now());
+    }
 
   private:
+    // Executors that only run the tasks placed on them.
+    struct Lane
+    {
+        std::string name;
+        std::vector<Executor<TaskRunner>> executors;
+        std::size_t current = 0; // Guarded by the scheduler lock.
+
+        std::atomic<std::uint64_t> runs{0};
+        std::atomic<std::int64_t> totalDelay{0}; // Microseconds.
+        std::atomic<std::int64_t> maxDelay{0};   // Microseconds.
+        std::atomic<std::int64_t> busy{0};       // Microseconds.
+
+        // Rate limit, as a virtual schedule: "earned" is the time the next
+        // token is due, i.e. the bucket is full when it is in the past.
+        // Guarded by the scheduler lock.
+        std::optional<RateLimit> limit;
+        time_point_t earned{};
+        std::uint64_t deferred = 0;
+
+        Lane(std::string laneName, std::size_t nExecutors)
+            : name(std::move(laneName)), executors(nExecutors)
+        {
+        }
+
+        // Takes a token for a due task. Returns the time to defer the task
+        // to, if none is available, reserving the token earned then. Expects
+        // the scheduler lock.
+        std::optional<time_point_t> admit(task_t &task, time_point_t now)
+        {
+            std::optional<time_point_t> ret;
+
+            if (task.admitted || !limit)
+            {
+                task.admitted = false;
+                return ret;
+            }
+
+            auto const tolerance =
+                limit->interval *
+                static_cast<std::chrono::microseconds::rep>(limit->burst - 1);
+            auto const next = std::max(earned, now);
+            earned = next + limit->interval;
+
+            if (next - tolerance > now)
+            {
+                task.admitted = true;
+                ++deferred;
+                ret = next - tolerance;
+            }
+
+            return ret;
+        }
+
+        // Expects the scheduler lock, unless the coordinator has stopped.
+        void dispatch(TaskRunner &&runner)
+        {
+            executors[current++ % executors.size()].add(std::move(runner));
+        }
+
+        template <class Delay, class Busy> void record(Delay delay, Busy spent)
+        {
+            using std::chrono::duration_cast;
+            using std::chrono::microseconds;
+
+            auto const late = std::max<std::int64_t>(
+                0, duration_cast<microseconds>(delay).count());
+
+            runs.fetch_add(1, std::memory_order_relaxed);
+            totalDelay.fetch_add(late, std::memory_order_relaxed);
+            busy.fetch_add(duration_cast<microseconds>(spent).count(),
+                           std::memory_order_relaxed);
+
+            auto prev = maxDelay.load(std::memory_order_relaxed);
+            while (prev < late && !maxDelay.compare_exchange_weak(
+                                      prev, late, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        LaneStats stats() const
+        {
+            using std::chrono::microseconds;
+
+            return {
+                .name = name,
+                .workers = executors.size(),
+                .runs = runs.load(std::memory_order_relaxed),
+                .deferred = deferred,
+                .totalDelay =
+                    microseconds(totalDelay.load(std::memory_order_relaxed)),
+                .maxDelay =
+                    microseconds(maxDelay.load(std::memory_order_relaxed)),
+                .busy = microseconds(busy.load(std::memory_order_relaxed))};
+        }
+    };
+
     // Collection of active tasks.
     task_map_t _tasks;
-    // Worker responsible for running tasks.
-    std::vector<BufferedWorker<TaskRunner>> _executors;
+    // Workers responsible for running tasks, the default lane first. Lanes
+    // are only appended, so references to them stay valid.
+    std::deque<Lane> _lanes;
     // Worker responsible for coordinating tasks.
     struct
     {
         std::thread consumer;
-        mutable std::mutex mtx;
-        mutable std::condition_variable cv;
+        mutable Lock mtx;
+        mutable condition_t cv;
         std::atomic_bool stop{false};
     } _scheduler;
+    // Tasks re-armed by executors, collected by the coordinator in batches
+    // instead of locking the scheduler on every execution.
+    detail::ReturnChannel<node_t> _rearms;
+    // Due time the coordinator sleeps until, as clock ticks: kNoTarget while
+    // there are no tasks and kAwake while it is not sleeping. Re-arms only
+    // wake the coordinator if they precede it.
+    static constexpr auto kNoTarget =
+        std::numeric_limits<typename time_point_t::rep>::max();
+    static constexpr auto kAwake =
+        std::numeric_limits<typename time_point_t::rep>::min();
+    std::atomic<typename time_point_t::rep> _waitTarget{kAwake};
+
+    // Tasks extracted by runDue(), kept to reuse its capacity.
+    std::vector<node_ptr_t> _due;
 
-    std::size_t _currentExecutor = 0;
     bool _countOnTaskStart;
+    bool const _embedded; // Constructed in the thread-free mode.
+    bool _draining = false; // Guarded by _scheduler.mtx.
+    // Coordinator wake ups, guarded by _scheduler.mtx.
+    std::uint64_t _wakeups = 0;
+    std::uint64_t _spuriousWakeups = 0;
+    // Declared last, so that clock notifications stop before anything else is
+    // torn down.
+    typename clock_traits_t::Subscription _clockSubscription;
 
   private:
-    void run();
+    // Expects the scheduler lock.
+    std::optional<LaneId> findLaneLocked(std::string_view name) const
+    {
+        std::optional<LaneId> ret;
+
+        for (std::size_t i = 0; i < _lanes.size(); ++i)
+        {
+            if (_lanes[i].name == name)
+            {
+                ret = static_cast<LaneId>(i);
+                break;
+            }
+        }
+
+        return ret;
+    }
+
+    // Computes the time point of the next occurrence of a calendar task,
+    // later than the current one, and moves the task to it.
+    static std::optional<time_point_t> nextOccurrence(task_t &task)
+    {
+        using namespace std::chrono;
+
+        std::optional<time_point_t> ret;
+        auto const now = Clock::now();
+        auto const wall = clock_traits_t::wallNow();
+
+        if (auto const next = task.calendar->next(
+                std::max(floor<seconds>(wall), task.occurrence)))
+        {
+            task.occurrence = *next;
+            ret = now + duration_cast<microseconds>(*next - wall);
+        }
+
+        return ret;
+    }
+
+    // Expects the scheduler lock.
+    void enqueue(time_point_t due, task_t &&task)
+    {
+        _tasks.push(
+            node_ptr_t(new node_t{.due = due, .task = std::move(task)}));
+    }
+
+    // Expects the scheduler lock.
+    void checkLane(LaneId lane) const
+    {
+        if (lane >= _lanes.size())
+        {
+            throw std::runtime_error(detail::kErrorUnknownLane);
+        }
+    }
+
+    void stopCoordinator()
+    {
+        {
+            std::lock_guard<Lock> lock(_scheduler.mtx);
+            _scheduler.stop = true;
+        }
+        _scheduler.cv.notify_one();
+        if (_scheduler.consumer.joinable())
+        {
+            _scheduler.consumer.join();
+        }
+    }
+
+    template <class Duration> static std::int64_t micros(Duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    // Wraps the condition of a coordinator wait, to count its wake ups, i.e.
+    // every evaluation but the first, and the spurious ones among them, that
+    // find nothing to do before the target. Expects the scheduler lock.
+    template <class Ready>
+    auto countingWakeups(Ready ready, time_point_t target)
+    {
+        return [this, ready, target, first = true]() mutable {
+            bool const ret = ready();
+            if (!std::exchange(first, false))
+            {
+                ++_wakeups;
+                detail::trace('i', "wake");
+                if (!ret && Clock::now() < target)
+                {
+                    ++_spuriousWakeups;
+                }
+            }
+            return ret;
+        };
+    }
+
+    // Called by executors, without the scheduler lock. The coordinator is
+    // either awake, hence collects the task before sleeping again, or is
+    // notified if the task is due before the coordinator's wake up time.
+    void rearm(node_ptr_t node)
+    {
+        if (_scheduler.stop)
+        {
+            return; // No re-arming during shutdown.
+        }
+
+        auto const due = node->due.time_since_epoch().count();
+        _rearms.push(std::move(node));
+        if (due < _waitTarget.load())
+        {
+            {
+                std::lock_guard<Lock> lock(_scheduler.mtx);
+            }
+            _scheduler.cv.notify_one();
+        }
+    }
+
+    // Expects the scheduler lock.
+    void collectRearms()
+    {
+        _rearms.consume(
+            [this](node_ptr_t &&node) { _tasks.push(std::move(node)); });
+    }
+
+    void run()
+    {
+        detail::traceLabel() = "coordinator";
+
+        while (!_scheduler.stop)
+        {
+            std::unique_lock<Lock> lock(_scheduler.mtx);
+            collectRearms();
+
+            // Waits publish their target before checking for re-arms, so
+            // that either the coordinator finds a re-arm pushed meanwhile, or
+            // the executor pushing it finds the target and wakes it if needed.
+            if (_tasks.empty())
+            {
+                _waitTarget.store(kNoTarget);
+                _scheduler.cv.wait(
+                    lock, countingWakeups(
+                              [this] {
+                                  return _scheduler.stop || !_tasks.empty() ||
+                                         !_rearms.empty();
+                              },
+                              time_point_t::max()));
+                _waitTarget.store(kAwake);
+
+                if (_scheduler.stop)
+                {
+                    break;
+                }
+                continue; // Collect re-arms.
+            }
+            else if (auto const target = _tasks.top().due;
+                     Clock::now() < target)
+            {
+                _waitTarget.store(target.time_since_epoch().count());
+                bool const preempted = clock_traits_t::waitUntil(
+                    _scheduler.cv, lock, target,
+                    countingWakeups(
+                        [this, &target] {
+                            // Stop or re-evaluate for earlier tasks.
+                            return _scheduler.stop ||
+                                   _tasks.top().due < target ||
+                                   !_rearms.empty();
+                        },
+                        target));
+                _waitTarget.store(kAwake);
+
+                if (_scheduler.stop)
+                {
+                    break;
+                }
+                if (preempted)
+                {
+                    continue;
+                }
+            }
+
+            if (auto const now = Clock::now(); now >= _tasks.top().due)
+            {
+                auto node = _tasks.pop();
+                auto &task = node->task;
+                if (task.cancelled())
+                {
+                    detail::trace('i', "skip", task.traceId());
+                    continue; // Reclaim without running.
+                }
+
+                auto &lane = _lanes[task.lane];
+                if (auto const until = lane.admit(task, now))
+                {
+                    detail::trace('i', "defer", task.traceId(),
+                                  micros(*until - now));
+                    node->due = *until;
+                    _tasks.push(std::move(node));
+                    continue;
+                }
+
+                detail::trace('i', "dispatch", task.traceId(),
+                              micros(now - node->due));
+
+                lane.dispatch(TaskRunner(*this, lane, std::move(node)));
+            }
+        }
+    }
 };
 
+/**
+ * @brief Scheduler running on the steady clock.
+ */
+using CallScheduler = BasicCallScheduler<std::chrono::steady_clock>;
+
+extern template class BasicCallScheduler<std::chrono::steady_clock>;
+
 } // namespace ttt
@@ -0,0 +1,53 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+namespace ttt
+{
+
+/**
+ * @brief Mutex that busy waits instead of parking the calling thread.
+ *
+ * @details Meant for locks held for a handful of instructions, e.g. the lock
+ * of a scheduler whose tasks are added and re-armed at a high rate, where
+ * parking and waking threads costs more than the wait. Waiters spin on a
+ * plain load, so that the cache line is only written when the lock is free,
+ * and yield between attempts.
+ */
+class SpinLock final
+{
+  public:
+    SpinLock() = default;
+
+    SpinLock(SpinLock const &) = delete;
+    SpinLock &operator=(SpinLock const &) = delete;
+
+    void lock() noexcept
+    {
+        while (_locked.exchange(true, std::memory_order_acquire))
+        {
+            while (_locked.load(std::memory_order_relaxed))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        return !_locked.load(std::memory_order_relaxed) &&
+               !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() noexcept
+    {
+        _locked.store(false, std::memory_order_release);
+    }
+
+  private:
+    std::atomic_bool _locked{false};
+};
+
+} // namespace ttt
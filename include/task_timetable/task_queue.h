@@ -0,0 +1,295 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ttt
+{
+
+/**
+ * @brief Pending task of a scheduler, owned by its queue while waiting.
+ *
+ * @tparam TimePoint Type of the due time.
+ * @tparam Task Type of the scheduled work.
+ */
+template <class TimePoint, class Task> struct TaskNode
+{
+    TimePoint due;
+    Task task;
+    std::size_t slot = 0;     // For the queue holding the node to use.
+    TaskNode *next = nullptr; // Link of the channel returning it to a queue.
+};
+
+/**
+ * @brief Requirements of the queue policy of schedulers.
+ *
+ * @details Queues own TaskNode objects, handed over as unique pointers, and
+ * are free to arrange them in any structure, e.g. a tree, a heap or a timing
+ * wheel:
+ * - push() adds a node.
+ * - top() and pop() access the node due first, expecting a non-empty queue.
+ * - erase() removes a node by its address, returning nothing if the node is
+ *   not in the queue.
+ * - countUntil() counts the nodes due not later than a time point.
+ */
+template <class Q>
+concept TaskQueue =
+    std::default_initializable<Q> &&
+    requires(Q q, Q const cq, std::unique_ptr<typename Q::node_type> node,
+             typename Q::node_type const *handle,
+             decltype(Q::node_type::due) until) {
+        q.push(std::move(node));
+        { q.pop() } -> std::same_as<std::unique_ptr<typename Q::node_type>>;
+        {
+            q.erase(handle)
+        } -> std::same_as<std::unique_ptr<typename Q::node_type>>;
+        { cq.top() } -> std::same_as<typename Q::node_type const &>;
+        { cq.empty() } -> std::convertible_to<bool>;
+        { cq.size() } -> std::convertible_to<std::size_t>;
+        { cq.countUntil(until) } -> std::convertible_to<std::size_t>;
+        q.clear();
+    };
+
+/**
+ * @brief Default queue policy of schedulers: tasks ordered by due time in a
+ * balanced tree. Tasks due at the same time are handed out in push order.
+ *
+ * @details The tree nodes of popped tasks are kept for reuse, up to the
+ * largest size the queue had, so that re-arming a repeating task does not
+ * allocate.
+ */
+template <class TimePoint, class Task> class OrderedTaskQueue
+{
+  public:
+    using node_type = TaskNode<TimePoint, Task>;
+
+    void push(std::unique_ptr<node_type> node)
+    {
+        if (_spare.empty())
+        {
+            auto const due = node->due;
+            _tree.emplace(due, std::move(node));
+            return;
+        }
+
+        auto handle = std::move(_spare.back());
+        _spare.pop_back();
+        handle.key() = node->due;
+        handle.mapped() = std::move(node);
+        _tree.insert(std::move(handle));
+    }
+
+    std::unique_ptr<node_type> pop()
+    {
+        return take(_tree.begin());
+    }
+
+    std::unique_ptr<node_type> erase(node_type const *node)
+    {
+        std::unique_ptr<node_type> ret;
+
+        auto [it, end] = _tree.equal_range(node->due);
+        for (; it != end; ++it)
+        {
+            if (it->second.get() == node)
+            {
+                ret = take(it);
+                break;
+            }
+        }
+
+        return ret;
+    }
+
+    node_type const &top() const
+    {
+        return *_tree.begin()->second;
+    }
+
+    bool empty() const
+    {
+        return _tree.empty();
+    }
+
+    std::size_t size() const
+    {
+        return _tree.size();
+    }
+
+    // Walks the due nodes, i.e. takes time proportional to their number.
+    std::size_t countUntil(TimePoint until) const
+    {
+        std::size_t ret = 0;
+        for (auto it = _tree.begin(); it != _tree.end() && it->first <= until;
+             ++it)
+        {
+            ++ret;
+        }
+        return ret;
+    }
+
+    void clear()
+    {
+        _tree.clear();
+        _spare.clear();
+    }
+
+  private:
+    using tree_t = std::multimap<TimePoint, std::unique_ptr<node_type>>;
+
+    std::unique_ptr<node_type> take(typename tree_t::iterator it)
+    {
+        auto handle = _tree.extract(it);
+        auto ret = std::move(handle.mapped());
+        _spare.push_back(std::move(handle));
+        return ret;
+    }
+
+  private:
+    tree_t _tree;
+    std::vector<typename tree_t::node_type> _spare; // Emptied tree nodes.
+};
+
+/**
+ * @brief Queue policy keeping tasks in a binary heap over a vector, i.e.
+ * without a memory allocation per task once the vector has grown. Tasks due
+ * at the same time are handed out in no particular order.
+ *
+ * @details Nodes record their position in the heap, so that they are erased
+ * without a search.
+ */
+template <class TimePoint, class Task> class HeapTaskQueue
+{
+  public:
+    using node_type = TaskNode<TimePoint, Task>;
+
+    void push(std::unique_ptr<node_type> node)
+    {
+        node->slot = _heap.size();
+        _heap.push_back(std::move(node));
+        siftUp(_heap.size() - 1);
+    }
+
+    std::unique_ptr<node_type> pop()
+    {
+        return take(0);
+    }
+
+    std::unique_ptr<node_type> erase(node_type const *node)
+    {
+        std::unique_ptr<node_type> ret;
+        if (node->slot < _heap.size() && _heap[node->slot].get() == node)
+        {
+            ret = take(node->slot);
+        }
+        return ret;
+    }
+
+    node_type const &top() const
+    {
+        return *_heap.front();
+    }
+
+    bool empty() const
+    {
+        return _heap.empty();
+    }
+
+    std::size_t size() const
+    {
+        return _heap.size();
+    }
+
+    // Only descends into due subtrees, i.e. takes time proportional to the
+    // number of due nodes.
+    std::size_t countUntil(TimePoint until) const
+    {
+        return countFrom(0, until);
+    }
+
+    void clear()
+    {
+        _heap.clear();
+    }
+
+  private:
+    std::size_t countFrom(std::size_t slot, TimePoint until) const
+    {
+        if (slot >= _heap.size() || until < _heap[slot]->due)
+        {
+            return 0;
+        }
+        return 1 + countFrom(2 * slot + 1, until) +
+               countFrom(2 * slot + 2, until);
+    }
+
+    std::unique_ptr<node_type> take(std::size_t slot)
+    {
+        swapSlots(slot, _heap.size() - 1);
+        auto ret = std::move(_heap.back());
+        _heap.pop_back();
+
+        if (slot < _heap.size())
+        {
+            siftDown(slot);
+            siftUp(slot);
+        }
+
+        return ret;
+    }
+
+    void siftUp(std::size_t slot)
+    {
+        while (slot > 0)
+        {
+            auto const parent = (slot - 1) / 2;
+            if (!(_heap[slot]->due < _heap[parent]->due))
+            {
+                break;
+            }
+            swapSlots(slot, parent);
+            slot = parent;
+        }
+    }
+
+    void siftDown(std::size_t slot)
+    {
+        while (true)
+        {
+            auto least = slot;
+            for (auto child : {2 * slot + 1, 2 * slot + 2})
+            {
+                if (child < _heap.size() &&
+                    _heap[child]->due < _heap[least]->due)
+                {
+                    least = child;
+                }
+            }
+
+            if (least == slot)
+            {
+                break;
+            }
+            swapSlots(slot, least);
+            slot = least;
+        }
+    }
+
+    void swapSlots(std::size_t a, std::size_t b)
+    {
+        std::swap(_heap[a], _heap[b]);
+        _heap[a]->slot = a;
+        _heap[b]->slot = b;
+    }
+
+  private:
+    std::vector<std::unique_ptr<node_type>> _heap;
+};
+
+} // namespace ttt
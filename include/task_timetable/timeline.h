@@ -5,7 +5,12 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -14,6 +19,12 @@ namespace ttt
 {
 
 class TimelineImpl;
+class TimelineStoreImpl;
+
+/**
+ * @brief Resolution that makes a timer lazy, i.e. invoked only on expiry.
+ */
+inline constexpr std::chrono::milliseconds kLazyResolution{0};
 
 /**
  * @brief Aggregate of values making up the state of a timer.
@@ -23,8 +34,122 @@ struct TimerState
     const std::string name;
     const std::chrono::milliseconds resolution;
     const std::chrono::milliseconds duration;
+    // Lazy timers update the remaining time when invoked or paused only;
+    // query a snapshot for its current value.
     std::atomic<std::chrono::milliseconds> remaining;
     const bool repeating;
+    const std::string group; // Empty if the timer belongs to no group.
+    const bool lazy;         // Invoked on expiry only, see kLazyResolution.
+};
+
+/**
+ * @brief Reference to a timer, for lock-free queries. Handles of removed
+ * timers are detected, even if their storage is reused.
+ */
+struct TimerHandle
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+};
+
+/**
+ * @brief Consistent copy of the state of a timer.
+ */
+struct TimerSnapshot
+{
+    std::chrono::milliseconds resolution; // kLazyResolution for lazy timers.
+    std::chrono::milliseconds duration;
+    std::chrono::milliseconds remaining;
+    bool repeating;
+    bool active; // Whether the timer is scheduled, i.e. not paused or stopped.
+    bool lazy;
+};
+
+/**
+ * @brief Timer tick, as delivered in batches.
+ */
+struct TimerTick
+{
+    std::string name;
+    TimerSnapshot state;
+};
+
+/**
+ * @brief Aggregate of values making up the state of a pulse.
+ */
+struct PulseState
+{
+    const std::string name;
+    const std::chrono::milliseconds period;
+    // Time of the last beat. The clock's epoch if the pulse never beat.
+    std::atomic<std::chrono::system_clock::time_point> lastBeat;
+    std::atomic_uint64_t beats;
+    // Beats that were due but did not happen, e.g. due to a late scheduler
+    // or while a persisted pulse was not loaded. Pauses do not count.
+    std::atomic_uint64_t missed;
+};
+
+/**
+ * @brief Copy of the liveness information of a pulse.
+ */
+struct PulseStatus
+{
+    std::chrono::system_clock::time_point lastBeat;
+    std::uint64_t beats;
+    std::uint64_t missed;
+    bool active;
+};
+
+/**
+ * @brief Aggregate of values making up the state of an alarm.
+ */
+struct AlarmState
+{
+    const std::string name;
+    const std::chrono::system_clock::time_point deadline;
+};
+
+/**
+ * @brief Timers targeted by a bulk operation.
+ */
+struct TimerSelection
+{
+    enum class Kind
+    {
+        Group,  // Timers tagged with the given group.
+        Prefix, // Timers whose name starts with the given prefix.
+        Names   // Timers with the given names.
+    };
+
+    Kind kind;
+    std::vector<std::string> values;
+
+    static TimerSelection group(std::string name)
+    {
+        return {Kind::Group, {std::move(name)}};
+    }
+
+    static TimerSelection prefix(std::string prefix)
+    {
+        return {Kind::Prefix, {std::move(prefix)}};
+    }
+
+    static TimerSelection names(std::vector<std::string> names)
+    {
+        return {Kind::Names, std::move(names)};
+    }
+};
+
+/**
+ * @brief Kinds of timer changes, as reported to timeline observers.
+ */
+enum class TimerChange
+{
+    Added,
+    Removed,
+    Stopped, // Stopped or paused, the reported state tells which.
+    Resumed,
+    Reset
 };
 
 // Split a state string into key and value.
@@ -46,13 +171,29 @@ std::string StateStringFrom(std::string const &key, std::string const &value);
  */
 class Timeline final
 {
+    friend class TimelineStoreImpl;
+
     std::unique_ptr<TimelineImpl> _impl;
 
+    // Observer of timer changes reserved for a store journaling them,
+    // invoked before the one set by users, which cannot replace it.
+    void setTimersJournal(
+        std::function<void(TimerChange, TimerState const &)> journal);
+
   public:
     /**
      * @brief Default constructed (empty) timeline.
      */
     Timeline();
+    /**
+     * @brief Empty timeline running on an externally owned scheduler. Many
+     * timelines can share a scheduler, sized to the machine, instead of each
+     * one owning its threads.
+     *
+     * @param scheduler Scheduler to run entities on. If null, the timeline
+     * creates a private scheduler.
+     */
+    explicit Timeline(std::shared_ptr<CallScheduler> scheduler);
     /**
      * @brief Construct a timeline out of serialized information. Entities
      * contained in the serialized string will be added to the internal
@@ -60,9 +201,37 @@ class Timeline final
      *
      * @param elements All entities as state strings.
      * @param timersEvent Callback that applies to timer events.
+     * @param scheduler Scheduler to run entities on. If null, the timeline
+     * creates a private scheduler.
+     * @param pulsesEvent Callback that applies to pulse beats, if any.
+     * @param alarmsEvent Callback that applies to alarms. Overdue alarms fire
+     * together, right after loading.
      */
-    explicit Timeline(std::vector<std::string> const &elements,
-                      std::function<void(TimerState const &)> timersEvent);
+    explicit Timeline(
+        std::vector<std::string> const &elements,
+        std::function<void(TimerState const &)> timersEvent,
+        std::shared_ptr<CallScheduler> scheduler = nullptr,
+        std::function<void(PulseState const &)> pulsesEvent = nullptr,
+        std::function<void(AlarmState const &)> alarmsEvent = nullptr);
+    /**
+     * @brief Construct a timeline out of a binary image, as produced by the
+     * binary overload of serialize.
+     *
+     * @param image Bytes of the image. Not referenced after construction.
+     * @param timersEvent Callback that applies to timer events.
+     * @param scheduler Scheduler to run entities on. If null, the timeline
+     * creates a private scheduler.
+     * @param pulsesEvent Callback that applies to pulse beats, if any.
+     * @param alarmsEvent Callback that applies to alarms. Overdue alarms fire
+     * together, right after loading.
+     *
+     * @throw std::runtime_error if the image is corrupt.
+     */
+    Timeline(std::span<const std::byte> image,
+             std::function<void(TimerState const &)> timersEvent,
+             std::shared_ptr<CallScheduler> scheduler = nullptr,
+             std::function<void(PulseState const &)> pulsesEvent = nullptr,
+             std::function<void(AlarmState const &)> alarmsEvent = nullptr);
     /**
      * @brief Move constructor.
      *
@@ -77,6 +246,10 @@ class Timeline final
     /**
      * @brief String representation of the state of all entities.
      *
+     * @details Timers are formatted from a consistent copy of their states,
+     * taken under a short lock, so large timelines can be serialized while
+     * timers are being added, removed or reset.
+     *
      * @param timers : whether to include the entity to the serialization.
      * @param pulses : whether to include the entity to the serialization.
      * @param alarms : whether to include the entity to the serialization.
@@ -86,24 +259,48 @@ class Timeline final
      */
     std::vector<std::string> serialize(bool timers, bool pulses,
                                        bool alarms) const;
+    /**
+     * @brief Compact binary representation of the state of all entities.
+     * Faster to produce and load than state strings.
+     *
+     * @param buffer Destination, where the image is appended.
+     * @param timers : whether to include the entity to the serialization.
+     * @param pulses : whether to include the entity to the serialization.
+     * @param alarms : whether to include the entity to the serialization.
+     *
+     * @return Number of bytes appended to the buffer.
+     */
+    std::size_t serialize(std::vector<std::byte> &buffer, bool timers,
+                          bool pulses, bool alarms) const;
 
     /**
      * @brief Add a timer to the timeline.
      *
      * @param name Timer description.
-     * @param resolution Interval between timer invocations.
+     * @param resolution Interval between timer invocations. kLazyResolution
+     * makes a lazy timer, invoked only on expiry: it wakes no thread while
+     * counting down and computes its remaining time from a deadline, hence
+     * does not drift when the scheduler runs late.
      * @param duration Total execution time for the timer.
      * @param repeating Whether to count from the top when reaching zero.
-     * @param onTick Callback to execute on invocation of the timer.
+     * @param onTick Callback to execute on invocation of the timer. Can be
+     * empty, e.g. for timers whose ticks are delivered in batches.
      * @param tickNow Immediately trigger the timer:
      *  - true : In the first call "remaining=duration".
      *  - false: First call with "remaining=duration-resolution".
+     * @param group Tag for bulk operations. Empty for no group.
+     * @param lane Scheduler lane running the timer ticks, e.g. a dedicated
+     * one for timers with slow callbacks. Not serialized: loaded timers run
+     * on the default lane.
      *
      * @return Whether the timer was added.
+     *
+     * @throw std::runtime_error if the scheduler has no such lane.
      */
     bool timerAdd(std::string const &name, std::chrono::milliseconds resolution,
                   std::chrono::milliseconds duration, bool repeating,
-                  std::function<void(TimerState const &)> onTick, bool tickNow);
+                  std::function<void(TimerState const &)> onTick, bool tickNow,
+                  std::string const &group = {}, LaneId lane = kDefaultLane);
     /**
      * @brief Remove the specified timer.
      *
@@ -146,9 +343,180 @@ class Timeline final
      * @return Whether timer event emission was resumed.
      */
     bool timerResume(std::string const &name);
+    /**
+     * @brief Bulk version of timerPause, applied in a single pass.
+     *
+     * @param selection Timers to pause.
+     *
+     * @return Number of timers selected.
+     */
+    std::size_t timersPause(TimerSelection const &selection);
+    /**
+     * @brief Bulk version of timerResume. Timers are re-armed with a single
+     * scheduler call.
+     *
+     * @param selection Timers to resume.
+     *
+     * @return Number of timers resumed.
+     */
+    std::size_t timersResume(TimerSelection const &selection);
+    /**
+     * @brief Bulk version of timerReset. Timers are re-armed with a single
+     * scheduler call.
+     *
+     * @param selection Timers to reset.
+     *
+     * @return Number of timers selected.
+     */
+    std::size_t timersReset(TimerSelection const &selection);
+    /**
+     * @brief Bulk version of timerStop, applied in a single pass.
+     *
+     * @param selection Timers to stop.
+     *
+     * @return Number of timers selected.
+     */
+    std::size_t timersStop(TimerSelection const &selection);
+    /**
+     * @brief Bulk version of timerRemove, applied in a single pass.
+     *
+     * @param selection Timers to remove.
+     *
+     * @return Number of timers removed.
+     */
+    std::size_t timersRemove(TimerSelection const &selection);
+    /**
+     * @brief Observe changes made to timers through this interface. Ticks are
+     * not reported.
+     *
+     * @param observer Invoked after a change, or before a removal, while the
+     * timeline is locked, so it must not call back into the timeline. Null
+     * stops the observation.
+     */
+    void setTimersObserver(
+        std::function<void(TimerChange, TimerState const &)> observer);
+    /**
+     * @brief Deliver timer ticks in batches, for subscribers with a high
+     * per-event cost. Timer actions, if any, still run on every tick.
+     *
+     * @param window Interval between deliveries. Ticks within a window are
+     * delivered together, in tick order.
+     * @param onBatch Invoked with the ticks of a window, if any. Null stops
+     * batching, after delivering the pending ticks.
+     * @param maxQueued If zero, batches are delivered on the scheduler.
+     * Otherwise they are queued to a dedicated thread, so a slow subscriber
+     * does not hold up ticking. Beyond maxQueued undelivered batches, the
+     * oldest ones are dropped.
+     */
+    void setTimersBatchDelivery(
+        std::chrono::milliseconds window,
+        std::function<void(std::span<const TimerTick>)> onBatch,
+        std::size_t maxQueued = 0);
+    /**
+     * @brief Look up a timer for lock-free queries. Takes the timeline lock,
+     * so handles are meant to be resolved once and reused.
+     *
+     * @param name Name of the timer.
+     *
+     * @return Handle of the timer, if it exists.
+     */
+    std::optional<TimerHandle> timerHandle(std::string const &name) const;
+    /**
+     * @brief Name of the timer a handle refers to. Takes the timeline lock.
+     *
+     * @param handle Timer handle, e.g. as visited by timersSnapshot.
+     *
+     * @return The name of the timer, if it still exists.
+     */
+    std::optional<std::string> timerName(TimerHandle handle) const;
+    /**
+     * @brief Consistent state of a timer, read without locking. Does not
+     * contend with ticks or with changes made through the timeline.
+     *
+     * @param handle Timer handle.
+     *
+     * @return The state of the timer, if it still exists.
+     */
+    std::optional<TimerSnapshot> timerSnapshot(TimerHandle handle) const;
+    /**
+     * @brief Visit the state of all timers, without locking. Each state is
+     * consistent on its own; timers added or removed during the visit may or
+     * may not be visited.
+     *
+     * @param visit Invoked per timer.
+     */
+    void timersSnapshot(
+        std::function<void(TimerHandle, TimerSnapshot const &)> const &visit)
+        const;
+
+    /**
+     * @brief Add a pulse to the timeline, i.e. a periodic heartbeat.
+     *
+     * @param name Pulse description.
+     * @param period Interval between beats.
+     * @param onBeat Callback to execute on every beat. Can be empty, for
+     * pulses that are only queried.
+     * @param beatNow Whether to immediately beat.
+     *
+     * @return Whether the pulse was added.
+     */
+    bool pulseAdd(std::string const &name, std::chrono::milliseconds period,
+                  std::function<void(PulseState const &)> onBeat, bool beatNow);
+    /**
+     * @brief Remove the specified pulse.
+     *
+     * @param name Name of the pulse to remove.
+     *
+     * @return Whether the pulse was removed.
+     */
+    bool pulseRemove(std::string const &name);
+    /**
+     * @brief Stop the beats of the specified pulse, keeping its state.
+     *
+     * @param name Name of the pulse to pause.
+     *
+     * @return Whether the pulse was paused.
+     */
+    bool pulsePause(std::string const &name);
+    /**
+     * @brief Start the beats of a paused pulse.
+     *
+     * @param name Name of the pulse to resume.
+     *
+     * @return Whether the pulse was resumed.
+     */
+    bool pulseResume(std::string const &name);
+    /**
+     * @brief Liveness information of the specified pulse.
+     *
+     * @param name Name of the pulse to query.
+     *
+     * @return The status of the pulse, if it exists.
+     */
+    std::optional<PulseStatus> pulseStatus(std::string const &name) const;
 
-    // Pulse
-    // Alarm
+    /**
+     * @brief Add a one-shot alarm to the timeline. Alarms that are due at the
+     * same time fire together, from a single scheduler task.
+     *
+     * @param name Alarm description.
+     * @param deadline Wall clock time to fire at. Past deadlines fire
+     * immediately.
+     * @param onFire Callback to execute when the alarm fires.
+     *
+     * @return Whether the alarm was added.
+     */
+    bool alarmAdd(std::string const &name,
+                  std::chrono::system_clock::time_point deadline,
+                  std::function<void(AlarmState const &)> onFire);
+    /**
+     * @brief Cancel the specified alarm.
+     *
+     * @param name Name of the alarm to remove.
+     *
+     * @return Whether the alarm was removed, i.e. it had not fired yet.
+     */
+    bool alarmRemove(std::string const &name);
 };
 
 } // namespace ttt
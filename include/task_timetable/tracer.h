@@ -0,0 +1,102 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+namespace ttt
+{
+
+namespace detail
+{
+
+constexpr char kErrorTraceFile[] = "Cannot write trace file";
+
+inline std::atomic_bool tracing{false};
+
+// Label of the calling thread in traces, e.g. "coordinator".
+inline char const *&traceLabel()
+{
+    thread_local char const *label = "thread";
+    return label;
+}
+
+void traceRecord(char phase, char const *name, std::uint64_t id,
+                 std::int64_t value);
+
+/**
+ * @brief Record an event of the calling thread, if tracing is enabled.
+ *
+ * @param phase Chrome trace event phase: 'i' instant, 'B' begin, 'E' end.
+ * @param name Event name, a string literal.
+ * @param id Identifier of the task involved, if any.
+ * @param value Event specific number, e.g. a lag in microseconds.
+ */
+inline void trace(char phase, char const *name, std::uint64_t id = 0,
+                  std::int64_t value = 0)
+{
+    if (tracing.load(std::memory_order_relaxed))
+    {
+        traceRecord(phase, name, id, value);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Process wide recorder of scheduler and executor activity.
+ *
+ * @details While tracing, every thread records its events in a ring buffer of
+ * its own, keeping the most recent ones. Recorded events:
+ * - "wake"     : the coordinator woke up.
+ * - "dispatch" : a due task was sent to an executor, with its lag behind the
+ *                due time in microseconds.
+ * - "defer"    : a due task was deferred by the rate limit of its lane.
+ * - "run"      : begin and end of a task execution on an executor.
+ * - "rearm"    : a task was scheduled again, with the delay until it is due.
+ * - "cancel"   : a token or task group was cancelled.
+ * - "skip"     : a cancelled task came due and was dropped.
+ * - "drop"     : a worker queue was full and dropped its oldest task.
+ * Traces are written in the Chrome trace event format, which both
+ * chrome://tracing and the Perfetto UI open. When tracing is disabled, the
+ * overhead of an instrumented point is a relaxed atomic load.
+ */
+class Tracer final
+{
+  public:
+    /**
+     * @brief Discard recorded events and start tracing.
+     *
+     * @param eventsPerThread Capacity of each thread's ring buffer.
+     */
+    static void start(std::size_t eventsPerThread = 1 << 16);
+
+    /**
+     * @brief Stop tracing, keeping the recorded events.
+     */
+    static void stop();
+
+    static bool enabled() noexcept
+    {
+        return detail::tracing.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Write the recorded events as a Chrome trace event JSON document.
+     *
+     * @return Number of events written.
+     */
+    static std::size_t write(std::ostream &out);
+
+    /**
+     * @brief Write the recorded events to a JSON file.
+     *
+     * @throw std::runtime_error if the file cannot be written.
+     */
+    static std::size_t write(std::filesystem::path const &file);
+};
+
+} // namespace ttt
@@ -0,0 +1,247 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include "buffered_worker.h"
+#include "tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ttt
+{
+
+namespace detail
+{
+
+constexpr char kErrorWorkerGroupSize[] =
+    "Worker group cannot have zero workers";
+
+}
+
+/**
+ * @brief A group of worker threads consuming a shared task queue.
+ *
+ * @details Keeps the contract of BufferedWorker, i.e. bounded queue length and
+ * a choice between dropping or executing leftover tasks upon destruction, but
+ * spreads task execution over multiple consumer threads. Features:
+ * - Consumers grab batches proportional to their share of the queue, so that
+ *   work is balanced without a lock acquisition per task.
+ * - Producers only signal consumers when some of them are parked.
+ *
+ * @tparam TaskType type of the unit of work.
+ */
+template <class TaskType> class WorkerGroup
+{
+  public:
+    using work_item_t = TaskType;
+
+    /**
+     * @brief Create a group with a worker per hardware thread, e.g. to serve
+     * as the executor of a scheduler lane.
+     */
+    WorkerGroup()
+        : WorkerGroup(std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    /**
+     * @brief Constructor
+     *
+     * @param nWorkers Number of consumer threads.
+     * @param maxLen Max allowed task queue size. Older tasks are replaced by
+     * new ones beyond this limit.
+     * @param dropLefoverTasks Group behavior when destruction happens with a
+     * non-empty task queue.
+     */
+    explicit WorkerGroup(unsigned nWorkers, std::size_t maxLen = 10'000,
+                         bool dropLefoverTasks = true)
+        : _nWorkers(nWorkers), _maxLen(maxLen), _stop(false),
+          _executeLeftoverTasks(!dropLefoverTasks)
+    {
+        if (0 == nWorkers)
+        {
+            throw std::runtime_error(detail::kErrorWorkerGroupSize);
+        }
+        if (0 == maxLen)
+        {
+            throw std::runtime_error(detail::kErrorWorkerSize);
+        }
+
+        _workers.reserve(nWorkers);
+        for (unsigned i = 0; i < nWorkers; ++i)
+        {
+            _workers.emplace_back(&WorkerGroup::consume, this);
+        }
+    }
+
+    ~WorkerGroup()
+    {
+        kill();
+    }
+
+    bool add(work_item_t work)
+    {
+        bool ret = false;
+
+        if (!_stop)
+        {
+            ret = true;
+            bool wakeConsumer = false;
+
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+
+                if (_tasks.size() >= _maxLen)
+                {
+                    _tasks.pop();
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    detail::trace('i', "drop");
+                }
+                else
+                {
+                    _pending.fetch_add(1, std::memory_order_relaxed);
+                }
+
+                _tasks.emplace(std::move(work));
+                wakeConsumer = _nParked > 0;
+            }
+
+            if (wakeConsumer)
+            {
+                _bell.notify_one();
+            }
+        }
+
+        return ret;
+    }
+
+    void kill()
+    {
+        if (!_stop)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+                _stop = true;
+            }
+            _bell.notify_all();
+
+            for (auto &worker : _workers)
+            {
+                worker.join();
+            }
+        }
+    }
+
+    /**
+     * @brief Stop the group after executing all pending tasks, regardless of
+     * the policy chosen on construction.
+     */
+    void drain()
+    {
+        _executeLeftoverTasks = true;
+        kill();
+    }
+
+    /**
+     * @brief Number of consumer threads in the group.
+     */
+    std::size_t size() const
+    {
+        return _nWorkers;
+    }
+
+    /**
+     * @brief Number of tasks waiting to run, readable without locking.
+     */
+    std::size_t pending() const
+    {
+        return _pending.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of tasks replaced by newer ones in a full queue.
+     */
+    std::uint64_t dropped() const
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void consume()
+    {
+        detail::traceLabel() = "worker group";
+        std::queue<work_item_t> batch;
+
+        while (fetchBatch(batch))
+        {
+            while (!batch.empty() && (!_stop || _executeLeftoverTasks))
+            {
+                std::invoke(batch.front());
+                batch.pop();
+                _pending.fetch_sub(1, std::memory_order_relaxed);
+            }
+            batch = {};
+        }
+    }
+
+    // Moves a share of the queued tasks to the batch. Returns false when the
+    // consumer should exit.
+    bool fetchBatch(std::queue<work_item_t> &batch)
+    {
+        bool wakeAnother = false;
+
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (!_stop && _tasks.empty())
+            {
+                ++_nParked;
+                _bell.wait(lock);
+                --_nParked;
+            }
+
+            if (_tasks.empty() || (_stop && !_executeLeftoverTasks))
+            {
+                return false;
+            }
+
+            auto share = std::max<std::size_t>(1, _tasks.size() / size());
+            while (share-- > 0)
+            {
+                batch.emplace(std::move(_tasks.front()));
+                _tasks.pop();
+            }
+
+            wakeAnother = !_tasks.empty() && _nParked > 0;
+        }
+
+        if (wakeAnother)
+        {
+            _bell.notify_one();
+        }
+
+        return true;
+    }
+
+  private:
+    std::vector<std::thread> _workers;
+    std::queue<work_item_t> _tasks;
+    mutable std::mutex _mtx;
+    mutable std::condition_variable _bell;
+    const unsigned _nWorkers;
+    const std::size_t _maxLen;
+    std::size_t _nParked = 0; // Guarded by _mtx.
+    std::atomic_bool _stop;
+    std::atomic_bool _executeLeftoverTasks;
+    std::atomic_size_t _pending{0};
+    std::atomic<std::uint64_t> _dropped{0};
+};
+
+} // namespace ttt
@@ -0,0 +1,424 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Compact binary representation of timeline entities.
+//
+// An image is a header followed by records:
+//
+//   header : u32 magic | u16 version | u16 reserved | u32 record count
+//   timer  : u8 type | u8 flags | u16 name length | i64 resolution (ms) |
+//            i64 duration (ms) | i64 remaining (ms) | name bytes |
+//            [u16 group length | group bytes], if flagged as grouped.
+//            Lazy timers are flagged as such, with a zero resolution
+//   pulse  : u8 type | u8 flags | u16 name length | i64 period (ms) |
+//            i64 last beat (ms since the system clock epoch) | u64 beats |
+//            u64 missed beats | name bytes
+//   alarm  : u8 type | u8 flags | u16 name length |
+//            i64 deadline (ms since the system clock epoch) | name bytes
+//   erase  : u8 type | u8 flags | u16 name length | name bytes
+//
+// Images contain timer, pulse and alarm records. Journals are header-less
+// sequences of timer and erase records. Integers are little endian,
+// regardless of the host.
+namespace ttt::detail
+{
+
+constexpr char kErrorCorruptImage[] = "Corrupt binary timeline image";
+constexpr char kErrorNameTooLong[] = "Entity name exceeds format limits";
+
+constexpr std::uint32_t kImageMagic = 0x42545454; // "TTTB"
+constexpr std::uint16_t kImageVersion = 1;
+constexpr std::size_t kImageHeaderSz = 12;
+
+enum class RecordType : std::uint8_t
+{
+    Timer = 1,
+    Erase = 2,
+    Pulse = 3,
+    Alarm = 4
+};
+
+constexpr std::uint8_t kFlagRepeating = 0x01;
+constexpr std::uint8_t kFlagActive = 0x02;
+constexpr std::uint8_t kFlagGrouped = 0x04;
+constexpr std::uint8_t kFlagLazy = 0x08;
+
+struct TimerRecord
+{
+    std::string_view name;
+    std::int64_t resolution;
+    std::int64_t duration;
+    std::int64_t remaining;
+    bool repeating;
+    bool active;
+    std::string_view group;
+    bool lazy;
+};
+
+struct PulseRecord
+{
+    std::string_view name;
+    std::int64_t period;
+    std::int64_t lastBeat;
+    std::uint64_t beats;
+    std::uint64_t missed;
+    bool active;
+};
+
+struct AlarmRecord
+{
+    std::string_view name;
+    std::int64_t deadline;
+};
+
+struct EraseRecord
+{
+    std::string_view name;
+};
+
+namespace record
+{
+
+template <class T> void store(std::byte *&dst, T value)
+{
+    auto const u = static_cast<std::make_unsigned_t<T>>(value);
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+    {
+        *dst++ = static_cast<std::byte>((u >> (8 * i)) & 0xFF);
+    }
+}
+
+// Extends the buffer, returning where the new bytes start.
+inline std::byte *grow(std::vector<std::byte> &out, std::size_t n)
+{
+    auto const pos = out.size();
+    out.resize(pos + n);
+    return out.data() + pos;
+}
+
+inline std::byte *putPrefix(std::vector<std::byte> &out, RecordType type,
+                            std::uint8_t flags, std::string_view name,
+                            std::size_t bodySz)
+{
+    if (name.size() > UINT16_MAX)
+    {
+        throw std::length_error(kErrorNameTooLong);
+    }
+
+    auto *dst = grow(out, 4 + bodySz + name.size());
+    store(dst, static_cast<std::uint8_t>(type));
+    store(dst, flags);
+    store(dst, static_cast<std::uint16_t>(name.size()));
+    return dst;
+}
+
+constexpr std::size_t kTimerSz = 28;
+
+inline void append(std::vector<std::byte> &out, TimerRecord const &rec)
+{
+    if (rec.group.size() > UINT16_MAX)
+    {
+        throw std::length_error(kErrorNameTooLong);
+    }
+
+    auto const groupSz = rec.group.empty() ? 0 : 2 + rec.group.size();
+    auto *dst = putPrefix(out, RecordType::Timer,
+                          static_cast<std::uint8_t>(
+                              (rec.repeating ? kFlagRepeating : 0) |
+                              (rec.active ? kFlagActive : 0) |
+                              (rec.group.empty() ? 0 : kFlagGrouped) |
+                              (rec.lazy ? kFlagLazy : 0)),
+                          rec.name, kTimerSz - 4 + groupSz);
+    store(dst, rec.resolution);
+    store(dst, rec.duration);
+    store(dst, rec.remaining);
+    std::memcpy(dst, rec.name.data(), rec.name.size());
+    if (!rec.group.empty())
+    {
+        dst += rec.name.size();
+        store(dst, static_cast<std::uint16_t>(rec.group.size()));
+        std::memcpy(dst, rec.group.data(), rec.group.size());
+    }
+}
+
+constexpr std::size_t kPulseSz = 36;
+
+inline void append(std::vector<std::byte> &out, PulseRecord const &rec)
+{
+    auto *dst = putPrefix(out, RecordType::Pulse,
+                          rec.active ? kFlagActive : std::uint8_t(0), rec.name,
+                          kPulseSz - 4);
+    store(dst, rec.period);
+    store(dst, rec.lastBeat);
+    store(dst, rec.beats);
+    store(dst, rec.missed);
+    std::memcpy(dst, rec.name.data(), rec.name.size());
+}
+
+constexpr std::size_t kAlarmSz = 12;
+
+inline void append(std::vector<std::byte> &out, AlarmRecord const &rec)
+{
+    auto *dst = putPrefix(out, RecordType::Alarm, 0, rec.name, kAlarmSz - 4);
+    store(dst, rec.deadline);
+    std::memcpy(dst, rec.name.data(), rec.name.size());
+}
+
+inline void append(std::vector<std::byte> &out, EraseRecord const &rec)
+{
+    auto *dst = putPrefix(out, RecordType::Erase, 0, rec.name, 0);
+    std::memcpy(dst, rec.name.data(), rec.name.size());
+}
+
+} // namespace record
+
+/**
+ * @brief Iterates a sequence of records, without copying.
+ */
+class RecordReader
+{
+    std::span<const std::byte> _in;
+    std::size_t _pos = 0;
+
+    void require(std::size_t n) const
+    {
+        if (_in.size() - _pos < n)
+        {
+            throw std::runtime_error(kErrorCorruptImage);
+        }
+    }
+
+    std::string_view getName(std::size_t len)
+    {
+        require(len);
+        auto const *chars = reinterpret_cast<char const *>(_in.data() + _pos);
+        _pos += len;
+        return {chars, len};
+    }
+
+  public:
+    explicit RecordReader(std::span<const std::byte> in) : _in(in)
+    {
+    }
+
+    template <class T> T get()
+    {
+        require(sizeof(T));
+        std::make_unsigned_t<T> u = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i)
+        {
+            u |= static_cast<std::make_unsigned_t<T>>(
+                     std::to_integer<std::uint8_t>(_in[_pos + i]))
+                 << (8 * i);
+        }
+        _pos += sizeof(T);
+        return static_cast<T>(u);
+    }
+
+    bool done() const
+    {
+        return _pos == _in.size();
+    }
+
+    // Bytes consumed so far.
+    std::size_t position() const
+    {
+        return _pos;
+    }
+
+    // Bytes left to consume.
+    std::size_t left() const
+    {
+        return _in.size() - _pos;
+    }
+
+    /**
+     * @brief Visits the next record.
+     *
+     * @details Record types the visitor cannot handle are treated as
+     * corruption.
+     *
+     * @throw std::runtime_error on corrupt or truncated records.
+     */
+    template <class Visitor> void next(Visitor &&visit)
+    {
+        auto const type = static_cast<RecordType>(get<std::uint8_t>());
+        auto const flags = get<std::uint8_t>();
+        auto const nameLen = get<std::uint16_t>();
+
+        if (RecordType::Timer == type &&
+            std::is_invocable_v<Visitor, TimerRecord const &>)
+        {
+            TimerRecord rec{};
+            rec.resolution = get<std::int64_t>();
+            rec.duration = get<std::int64_t>();
+            rec.remaining = get<std::int64_t>();
+            rec.name = getName(nameLen);
+            rec.repeating = flags & kFlagRepeating;
+            rec.active = flags & kFlagActive;
+            rec.lazy = flags & kFlagLazy;
+            if (flags & kFlagGrouped)
+            {
+                rec.group = getName(get<std::uint16_t>());
+            }
+            if constexpr (std::is_invocable_v<Visitor, TimerRecord const &>)
+            {
+                visit(rec);
+            }
+        }
+        else if (RecordType::Pulse == type &&
+                 std::is_invocable_v<Visitor, PulseRecord const &>)
+        {
+            PulseRecord rec{};
+            rec.period = get<std::int64_t>();
+            rec.lastBeat = get<std::int64_t>();
+            rec.beats = get<std::uint64_t>();
+            rec.missed = get<std::uint64_t>();
+            rec.name = getName(nameLen);
+            rec.active = flags & kFlagActive;
+            if constexpr (std::is_invocable_v<Visitor, PulseRecord const &>)
+            {
+                visit(rec);
+            }
+        }
+        else if (RecordType::Alarm == type &&
+                 std::is_invocable_v<Visitor, AlarmRecord const &>)
+        {
+            AlarmRecord rec{};
+            rec.deadline = get<std::int64_t>();
+            rec.name = getName(nameLen);
+            if constexpr (std::is_invocable_v<Visitor, AlarmRecord const &>)
+            {
+                visit(rec);
+            }
+        }
+        else if (RecordType::Erase == type &&
+                 std::is_invocable_v<Visitor, EraseRecord const &>)
+        {
+            EraseRecord rec{getName(nameLen)};
+            if constexpr (std::is_invocable_v<Visitor, EraseRecord const &>)
+            {
+                visit(rec);
+            }
+        }
+        else
+        {
+            throw std::runtime_error(kErrorCorruptImage);
+        }
+    }
+};
+
+/**
+ * @brief Appends an image to a byte buffer.
+ */
+class ImageWriter
+{
+    std::vector<std::byte> &_out;
+    std::size_t _headerPos;
+    std::uint32_t _count = 0;
+
+  public:
+    static constexpr std::size_t kTimerRecordSz = record::kTimerSz;
+    static constexpr std::size_t kPulseRecordSz = record::kPulseSz;
+    static constexpr std::size_t kAlarmRecordSz = record::kAlarmSz;
+
+    // Starts an image at the end of the buffer.
+    explicit ImageWriter(std::vector<std::byte> &out)
+        : _out(out), _headerPos(out.size())
+    {
+        auto *dst = record::grow(_out, kImageHeaderSz);
+        record::store(dst, kImageMagic);
+        record::store(dst, kImageVersion);
+        record::store(dst, std::uint16_t(0));
+        record::store(dst, _count);
+    }
+
+    // Patches the record count in the header.
+    ~ImageWriter()
+    {
+        auto *dst = _out.data() + _headerPos + 8;
+        record::store(dst, _count);
+    }
+
+    ImageWriter(ImageWriter const &) = delete;
+    ImageWriter &operator=(ImageWriter const &) = delete;
+
+    void reserve(std::size_t nBytes)
+    {
+        _out.reserve(_out.size() + nBytes);
+    }
+
+    template <class Record> void write(Record const &rec)
+    {
+        record::append(_out, rec);
+        ++_count;
+    }
+};
+
+/**
+ * @brief Iterates the entity records of an image, without copying.
+ */
+class ImageReader
+{
+    static constexpr std::size_t kMinRecordSz =
+        std::min({record::kTimerSz, record::kPulseSz, record::kAlarmSz});
+
+    RecordReader _records;
+    std::uint32_t _remaining = 0;
+
+  public:
+    explicit ImageReader(std::span<const std::byte> in) : _records(in)
+    {
+        if (_records.get<std::uint32_t>() != kImageMagic ||
+            _records.get<std::uint16_t>() != kImageVersion)
+        {
+            throw std::runtime_error(kErrorCorruptImage);
+        }
+        _records.get<std::uint16_t>(); // Reserved.
+        _remaining = _records.get<std::uint32_t>();
+
+        // The count sizes allocations, so it must fit in the image.
+        if (_remaining > _records.left() / kMinRecordSz)
+        {
+            throw std::runtime_error(kErrorCorruptImage);
+        }
+    }
+
+    // Number of records, bounded by the size of the image.
+    std::size_t size() const
+    {
+        return _remaining;
+    }
+
+    // Visits the next record. Returns false when the image is exhausted.
+    template <class Visitor> bool next(Visitor &&visit)
+    {
+        if (0 == _remaining)
+        {
+            return false;
+        }
+        --_remaining;
+
+        _records.next(std::forward<Visitor>(visit));
+        return true;
+    }
+
+    // Bytes consumed so far.
+    std::size_t position() const
+    {
+        return _records.position();
+    }
+};
+
+} // namespace ttt::detail
@@ -0,0 +1,215 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "task_timetable/calendar.h"
+
+#include <charconv>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+using namespace std::chrono;
+
+// Years searched for an occurrence, i.e. more than a full cycle of leap years
+// and weekdays.
+constexpr int kHorizonYears = 400;
+
+[[noreturn]] void fail()
+{
+    throw std::runtime_error(ttt::detail::kErrorCalendarExpression);
+}
+
+std::vector<std::string_view> split(std::string_view text, char delimiter)
+{
+    std::vector<std::string_view> ret;
+
+    while (!text.empty())
+    {
+        auto const pos = text.find(delimiter);
+        ret.push_back(text.substr(0, pos));
+        if (std::string_view::npos == pos)
+        {
+            break;
+        }
+        text.remove_prefix(pos + 1);
+    }
+
+    return ret;
+}
+
+unsigned toNumber(std::string_view text)
+{
+    unsigned ret = 0;
+
+    auto const end = text.data() + text.size();
+    auto const [ptr, ec] = std::from_chars(text.data(), end, ret);
+    if (text.empty() || std::errc{} != ec || end != ptr)
+    {
+        fail();
+    }
+
+    return ret;
+}
+
+// Sets the bits of the values in a field. Returns whether the field is
+// unrestricted, i.e. starts with "*".
+template <std::size_t N>
+bool parseField(std::string_view field, unsigned lo, unsigned hi,
+                std::bitset<N> &bits)
+{
+    if (field.empty())
+    {
+        fail();
+    }
+
+    for (auto item : split(field, ','))
+    {
+        unsigned step = 1;
+        if (auto const slash = item.find('/'); std::string_view::npos != slash)
+        {
+            step = toNumber(item.substr(slash + 1));
+            item = item.substr(0, slash);
+            if (0 == step)
+            {
+                fail();
+            }
+        }
+
+        unsigned first = lo, last = hi;
+        if ("*" != item)
+        {
+            auto const dash = item.find('-');
+            first = toNumber(item.substr(0, dash));
+            if (std::string_view::npos != dash)
+            {
+                last = toNumber(item.substr(dash + 1));
+            }
+            else if (1 == step)
+            {
+                last = first; // A single value, unless stepping from it.
+            }
+        }
+
+        if (first < lo || last > hi || first > last)
+        {
+            fail();
+        }
+        for (auto value = first; value <= last; value += step)
+        {
+            bits.set(value);
+        }
+    }
+
+    return '*' == field.front();
+}
+
+// Position of the first set bit, starting from the given one. N if none.
+template <std::size_t N>
+std::size_t nextBit(std::bitset<N> const &bits, std::size_t from)
+{
+    while (from < N && !bits[from])
+    {
+        ++from;
+    }
+    return from;
+}
+
+} // namespace
+
+namespace ttt
+{
+
+CalendarSchedule::CalendarSchedule(std::string_view expression,
+                                   std::chrono::minutes utcOffset)
+    : _utcOffset(utcOffset)
+{
+    std::vector<std::string_view> fields;
+    for (auto field : split(expression, ' '))
+    {
+        if (!field.empty()) // Consecutive spaces.
+        {
+            fields.push_back(field);
+        }
+    }
+    if (5 != fields.size())
+    {
+        fail();
+    }
+
+    std::bitset<8> weekDays; // Sunday as both 0 and 7.
+
+    parseField(fields[0], 0, 59, _minutes);
+    parseField(fields[1], 0, 23, _hours);
+    _anyMonthDay = parseField(fields[2], 1, 31, _monthDays);
+    parseField(fields[3], 1, 12, _months);
+    _anyWeekDay = parseField(fields[4], 0, 7, weekDays);
+
+    for (std::size_t i = 0; i < _weekDays.size(); ++i)
+    {
+        _weekDays[i] = weekDays[i];
+    }
+    _weekDays[0] = weekDays[0] || weekDays[7];
+}
+
+std::optional<CalendarSchedule::time_point> CalendarSchedule::next(
+    time_point after) const
+{
+    // Fields refer to local time.
+    auto t = floor<minutes>(after + _utcOffset) + minutes(1);
+    auto const lastYear =
+        static_cast<int>(year_month_day(floor<days>(t)).year()) +
+        kHorizonYears;
+
+    while (true)
+    {
+        auto const day = floor<days>(t);
+        year_month_day const date(day);
+
+        if (static_cast<int>(date.year()) > lastYear)
+        {
+            return std::nullopt;
+        }
+        if (!_months[static_cast<unsigned>(date.month())])
+        {
+            t = sys_days((date.year() / date.month() + months(1)) / 1);
+            continue;
+        }
+        if (!matchesDay(date))
+        {
+            t = day + days(1);
+            continue;
+        }
+
+        auto const minuteOfDay = static_cast<std::size_t>((t - day).count());
+        auto const hour = minuteOfDay / 60;
+        auto const nextHour = nextBit(_hours, hour);
+        if (nextHour != hour)
+        {
+            // Also moves past the last hour of the day.
+            t = day + hours(nextHour);
+            continue;
+        }
+
+        auto const minute = minuteOfDay % 60;
+        auto const nextMinute = nextBit(_minutes, minute);
+        if (nextMinute == _minutes.size())
+        {
+            t = day + hours(hour + 1);
+            continue;
+        }
+
+        return t + minutes(nextMinute - minute) - _utcOffset;
+    }
+}
+
+bool CalendarSchedule::matchesDay(year_month_day const &date) const
+{
+    bool const monthDay = _monthDays[static_cast<unsigned>(date.day())];
+    bool const weekDay = _weekDays[weekday(sys_days(date)).c_encoding()];
+
+    return (_anyMonthDay || _anyWeekDay) ? monthDay && weekDay
+                                         : monthDay || weekDay;
+}
+
+} // namespace ttt
@@ -0,0 +1,104 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "task_timetable/clock.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace ttt
+{
+
+namespace
+{
+
+struct VirtualClockState
+{
+    std::atomic<VirtualClock::rep> ticks{0};
+    std::mutex mtx;
+    std::list<std::function<void()>> listeners;
+};
+
+VirtualClockState &state()
+{
+    static VirtualClockState s;
+    return s;
+}
+
+void notifyListeners()
+{
+    auto &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    for (auto &onAdvance : s.listeners)
+    {
+        onAdvance();
+    }
+}
+
+} // namespace
+
+VirtualClock::Subscription::Subscription(
+    std::list<std::function<void()>>::iterator it)
+    : _it(it), _active(true)
+{
+}
+
+VirtualClock::Subscription::Subscription(Subscription &&other) noexcept
+    : _it(other._it), _active(other._active)
+{
+    other._active = false;
+}
+
+VirtualClock::Subscription &VirtualClock::Subscription::operator=(
+    Subscription &&other) noexcept
+{
+    if (this != &other)
+    {
+        Subscription expiring(std::move(*this));
+        _it = other._it;
+        _active = other._active;
+        other._active = false;
+    }
+    return *this;
+}
+
+VirtualClock::Subscription::~Subscription()
+{
+    if (_active)
+    {
+        auto &s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.listeners.erase(_it);
+    }
+}
+
+VirtualClock::time_point VirtualClock::now() noexcept
+{
+    return time_point(duration(state().ticks.load()));
+}
+
+void VirtualClock::advance(duration d)
+{
+    state().ticks.fetch_add(d.count());
+    notifyListeners();
+}
+
+void VirtualClock::advanceTo(time_point tp)
+{
+    auto &ticks = state().ticks;
+    auto const target = tp.time_since_epoch().count();
+    auto current = ticks.load();
+    while (current < target && !ticks.compare_exchange_weak(current, target))
+    {
+    }
+    notifyListeners();
+}
+
+VirtualClock::Subscription VirtualClock::subscribe(
+    std::function<void()> onAdvance)
+{
+    auto &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+    return Subscription(
+        s.listeners.insert(s.listeners.end(), std::move(onAdvance)));
+}
+
+} // namespace ttt
@@ -0,0 +1,513 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "task_timetable/persistence.h"
+#include "binary_format.h"
+#include "task_timetable/buffered_worker.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+constexpr char kErrorStoreRead[] = "Cannot read timeline store file";
+constexpr char kErrorStoreWrite[] = "Cannot write timeline store file";
+
+constexpr char kSnapshotFile[] = "timeline.snapshot";
+constexpr char kSnapshotTmpFile[] = "timeline.snapshot.tmp";
+constexpr char kJournalPrefix[] = "timeline.journal.";
+
+constexpr std::size_t kSnapshotHeaderSz = sizeof(std::uint64_t);
+
+/**
+ * @brief Read-only view of a whole file.
+ *
+ * @details Memory mapped where supported, read into memory otherwise.
+ */
+class MappedFile
+{
+#ifdef _WIN32
+    std::vector<std::byte> _data;
+#else
+    void *_addr = nullptr;
+    std::size_t _size = 0;
+#endif
+
+  public:
+    explicit MappedFile(fs::path const &path)
+    {
+#ifdef _WIN32
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            throw std::runtime_error(kErrorStoreRead);
+        }
+        _data.resize(fs::file_size(path));
+        in.read(reinterpret_cast<char *>(_data.data()),
+                static_cast<std::streamsize>(_data.size()));
+        if (!in)
+        {
+            throw std::runtime_error(kErrorStoreRead);
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error(kErrorStoreRead);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            _size = static_cast<std::size_t>(st.st_size);
+            _addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+
+        if (MAP_FAILED == _addr)
+        {
+            throw std::runtime_error(kErrorStoreRead);
+        }
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (_addr)
+        {
+            ::munmap(_addr, _size);
+        }
+#endif
+    }
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile &operator=(MappedFile const &) = delete;
+
+    std::span<const std::byte> bytes() const
+    {
+#ifdef _WIN32
+        return _data;
+#else
+        return {static_cast<std::byte const *>(_addr), _size};
+#endif
+    }
+};
+
+// Flush file contents to the storage device, where supported.
+void syncFile([[maybe_unused]] fs::path const &path)
+{
+#ifndef _WIN32
+    if (int fd = ::open(path.c_str(), O_RDONLY); fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+fs::path journalPath(fs::path const &dir, std::uint64_t seq)
+{
+    return dir / (kJournalPrefix + std::to_string(seq));
+}
+
+// Sequence numbers of the journals in a directory, in ascending order.
+std::vector<std::uint64_t> journalSequences(fs::path const &dir)
+{
+    std::vector<std::uint64_t> ret;
+    std::string_view const prefix(kJournalPrefix);
+
+    for (auto const &entry : fs::directory_iterator(dir))
+    {
+        auto const name = entry.path().filename().string();
+        if (name.starts_with(prefix))
+        {
+            std::uint64_t seq = 0;
+            auto const *first = name.data() + prefix.size();
+            auto const *last = name.data() + name.size();
+            if (auto [end, ec] = std::from_chars(first, last, seq);
+                ec == std::errc{} && end == last)
+            {
+                ret.push_back(seq);
+            }
+        }
+    }
+
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+// Timer record that owns its strings.
+struct OwnedRecord
+{
+    ttt::detail::TimerRecord rec;
+    std::string group;
+};
+
+// Timer records keyed by name. Record names view the keys.
+using TimerMap = std::map<std::string, OwnedRecord, std::less<>>;
+
+void upsert(TimerMap &timers, ttt::detail::TimerRecord const &rec)
+{
+    auto [it, inserted] = timers.try_emplace(std::string(rec.name));
+    auto &owned = it->second;
+    owned.group = rec.group;
+    owned.rec = rec;
+    owned.rec.name = it->first;
+    owned.rec.group = owned.group;
+}
+
+// Applies the records of a journal. A truncated or corrupt tail, as left by
+// a crash during a write, ends the replay of the journal.
+bool replayJournal(fs::path const &path, TimerMap &timers)
+{
+    bool ret = false;
+    MappedFile file(path);
+    ttt::detail::RecordReader records(file.bytes());
+
+    try
+    {
+        while (!records.done())
+        {
+            records.next([&timers](auto const &rec) {
+                using rec_t = std::decay_t<decltype(rec)>;
+                if constexpr (std::is_same_v<rec_t, ttt::detail::EraseRecord>)
+                {
+                    if (auto it = timers.find(rec.name); timers.end() != it)
+                    {
+                        timers.erase(it);
+                    }
+                }
+                else if constexpr (std::is_same_v<rec_t,
+                                                  ttt::detail::TimerRecord>)
+                {
+                    upsert(timers, rec);
+                }
+                else
+                {
+                    throw std::runtime_error(ttt::detail::kErrorCorruptImage);
+                }
+            });
+            ret = true;
+        }
+    }
+    catch (std::runtime_error const &)
+    {
+    }
+
+    return ret;
+}
+
+ttt::detail::TimerRecord recordFrom(ttt::TimerState const &state, bool active)
+{
+    return {.name = state.name,
+            .resolution = state.resolution.count(),
+            .duration = state.duration.count(),
+            .remaining = state.remaining.load().count(),
+            .repeating = state.repeating,
+            .active = active,
+            .group = state.group,
+            .lazy = state.lazy};
+}
+
+} // namespace
+
+namespace ttt
+{
+
+class TimelineStoreImpl
+{
+    fs::path const _dir;
+    std::size_t const _compactAfter;
+
+    std::mutex _compactionMtx; // Serializes compactions.
+
+    std::mutex _journalMtx;
+    std::ofstream _journal;          // Guarded by _journalMtx.
+    std::uint64_t _journalSeq = 0;   // Guarded by _journalMtx.
+    std::size_t _nRecords = 0;       // Guarded by _journalMtx.
+    bool _compactionPending = false; // Guarded by _journalMtx.
+    std::vector<std::byte> _record;  // Guarded by _journalMtx.
+    // Journal that failed a write, if any. Guarded by _journalMtx.
+    std::optional<std::uint64_t> _failedJournal;
+
+    std::optional<Timeline> _timeline;
+    // Declared last: stops before the timeline and journal are destroyed.
+    BufferedWorker<std::function<void()>> _compactor;
+
+  public:
+    TimelineStoreImpl(fs::path const &directory,
+                      std::function<void(TimerState const &)> timersEvent,
+                      std::shared_ptr<CallScheduler> scheduler,
+                      std::size_t compactAfter)
+        : _dir(directory), _compactAfter(std::max<std::size_t>(compactAfter, 1))
+    {
+        fs::create_directories(_dir);
+
+        std::optional<MappedFile> snapshot;
+        std::uint64_t snapshotSeq = 0;
+        std::span<const std::byte> image;
+        if (fs::exists(_dir / kSnapshotFile))
+        {
+            snapshot.emplace(_dir / kSnapshotFile);
+            detail::RecordReader header(snapshot->bytes());
+            snapshotSeq = header.get<std::uint64_t>();
+            image = snapshot->bytes().subspan(kSnapshotHeaderSz);
+        }
+
+        // Journals older than the snapshot are covered by it.
+        auto const journals = journalSequences(_dir);
+        bool const replay =
+            std::any_of(journals.begin(), journals.end(),
+                        [snapshotSeq](auto seq) { return seq >= snapshotSeq; });
+
+        TimerMap timers;
+        bool journaled = false;
+        if (replay && !image.empty())
+        {
+            detail::ImageReader reader(image);
+            while (reader.next([&timers](detail::TimerRecord const &rec) {
+                upsert(timers, rec);
+            }))
+            {
+            }
+        }
+        for (auto seq : journals)
+        {
+            if (seq >= snapshotSeq)
+            {
+                journaled |= replayJournal(journalPath(_dir, seq), timers);
+            }
+        }
+
+        _journalSeq = std::max<std::uint64_t>(
+            snapshotSeq, journals.empty() ? 0 : journals.back());
+        ++_journalSeq;
+
+        if (journaled)
+        {
+            // Persist the merged state, so the replayed journals can go.
+            std::vector<std::byte> merged;
+            {
+                detail::ImageWriter writer(merged);
+                for (auto const &[name, owned] : timers)
+                {
+                    writer.write(owned.rec);
+                }
+            }
+            snapshot.reset();
+            _timeline.emplace(merged, std::move(timersEvent),
+                              std::move(scheduler));
+            writeSnapshot(_journalSeq, merged);
+        }
+        else if (image.empty())
+        {
+            std::vector<std::byte> empty;
+            detail::ImageWriter{empty};
+            _timeline.emplace(empty, std::move(timersEvent),
+                              std::move(scheduler));
+        }
+        else
+        {
+            // Loaded straight from the mapped snapshot.
+            _timeline.emplace(image, std::move(timersEvent),
+                              std::move(scheduler));
+        }
+        dropJournals(_journalSeq);
+        openJournal();
+
+        _timeline->setTimersJournal(
+            [this](TimerChange change, TimerState const &state) {
+                journal(change, state);
+            });
+    }
+
+    ~TimelineStoreImpl()
+    {
+        _compactor.kill();
+        _timeline->setTimersJournal(nullptr);
+    }
+
+    Timeline &timeline()
+    {
+        return *_timeline;
+    }
+
+    bool healthy()
+    {
+        std::lock_guard<std::mutex> lock(_journalMtx);
+        return !_failedJournal;
+    }
+
+    void compact()
+    {
+        std::lock_guard<std::mutex> compactionLock(_compactionMtx);
+
+        // Changes made from now on go to a new journal. Those that make it to
+        // the snapshot as well, are idempotent when replayed.
+        std::uint64_t seq = 0;
+        {
+            std::lock_guard<std::mutex> lock(_journalMtx);
+            seq = ++_journalSeq;
+            openJournal();
+            _nRecords = 0;
+        }
+
+        std::vector<std::byte> image;
+        _timeline->serialize(image, true, false, false);
+        writeSnapshot(seq, image);
+
+        std::lock_guard<std::mutex> lock(_journalMtx);
+        _compactionPending = false;
+        if (_failedJournal && *_failedJournal < seq)
+        {
+            _failedJournal.reset(); // Lost changes are in the snapshot.
+        }
+    }
+
+  private:
+    // Replaces the snapshot, then drops the journals it covers.
+    void writeSnapshot(std::uint64_t seq, std::span<const std::byte> image)
+    {
+        std::vector<std::byte> header;
+        auto *dst = detail::record::grow(header, kSnapshotHeaderSz);
+        detail::record::store(dst, seq);
+
+        auto const tmp = _dir / kSnapshotTmpFile;
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<char const *>(header.data()),
+                      static_cast<std::streamsize>(header.size()));
+            out.write(reinterpret_cast<char const *>(image.data()),
+                      static_cast<std::streamsize>(image.size()));
+            if (!out.flush())
+            {
+                throw std::runtime_error(kErrorStoreWrite);
+            }
+        }
+        syncFile(tmp);
+        fs::rename(tmp, _dir / kSnapshotFile);
+
+        dropJournals(seq);
+    }
+
+    // Removes the journals older than the given sequence number.
+    void dropJournals(std::uint64_t seq)
+    {
+        for (auto old : journalSequences(_dir))
+        {
+            if (old < seq)
+            {
+                std::error_code ec; // Leftovers are ignored on the next load.
+                fs::remove(journalPath(_dir, old), ec);
+            }
+        }
+    }
+
+    // Starts the journal of the current sequence number.
+    void openJournal()
+    {
+        _journal = std::ofstream(journalPath(_dir, _journalSeq),
+                                 std::ios::binary | std::ios::app);
+        if (!_journal)
+        {
+            throw std::runtime_error(kErrorStoreWrite);
+        }
+    }
+
+    // Invoked by the timeline while it is locked, in the middle of a change
+    // that is already applied. Failures are recorded instead of thrown, and
+    // stop journaling until a new journal is opened by compaction.
+    void journal(TimerChange change, TimerState const &state)
+    {
+        std::lock_guard<std::mutex> lock(_journalMtx);
+        if (_failedJournal == _journalSeq)
+        {
+            return; // Records after a failed one would leave a gap.
+        }
+
+        _record.clear();
+        if (TimerChange::Removed == change)
+        {
+            detail::record::append(_record, detail::EraseRecord{state.name});
+        }
+        else
+        {
+            detail::record::append(
+                _record, recordFrom(state, TimerChange::Stopped != change));
+        }
+
+        _journal.write(reinterpret_cast<char const *>(_record.data()),
+                       static_cast<std::streamsize>(_record.size()));
+        if (!_journal.flush())
+        {
+            _failedJournal = _journalSeq;
+        }
+
+        if (++_nRecords >= _compactAfter && !_compactionPending)
+        {
+            _compactionPending = true;
+            _compactor.add([this] {
+                try
+                {
+                    compact();
+                }
+                catch (std::exception const &)
+                {
+                    // Retried once more changes are journaled.
+                    std::lock_guard<std::mutex> lock(_journalMtx);
+                    _compactionPending = false;
+                }
+            });
+        }
+    }
+};
+
+TimelineStore::TimelineStore(
+    std::filesystem::path const &directory,
+    std::function<void(TimerState const &)> timersEvent,
+    std::shared_ptr<CallScheduler> scheduler, std::size_t compactAfter)
+    : _impl(std::make_unique<TimelineStoreImpl>(
+          directory, std::move(timersEvent), std::move(scheduler),
+          compactAfter))
+{
+}
+
+TimelineStore::~TimelineStore() = default;
+
+Timeline &TimelineStore::timeline()
+{
+    return _impl->timeline();
+}
+
+bool TimelineStore::healthy() const
+{
+    return _impl->healthy();
+}
+
+void TimelineStore::compact()
+{
+    _impl->compact();
+}
+
+} // namespace ttt
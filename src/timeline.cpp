@@ -1,16 +1,26 @@
 // © 2022 Nikolaos Athanasiou, github.com/picanumber
 #include "task_timetable/timeline.h"
+#include "binary_format.h"
+#include "task_timetable/buffered_worker.h"
 #include "task_timetable/scheduler.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
-#include <map>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <optional>
-#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #if 0
 #include <concepts>
@@ -29,37 +39,105 @@ constexpr char kAlarmElement[] = "alarm";
 
 constexpr short kElementFieldSz = std::extent<decltype(kTimerElement)>::value;
 
-constexpr char kNotIMplemented[] = "Feature not implemented";
 constexpr char kInvalidTimerCountdown[] = "Timers cannot tick beyond zero";
+constexpr char kInvalidTimerResolution[] = "Only lazy timers lack resolution";
 constexpr char kInvalidElementType[] = "Type not one of timer-pulse-alarm";
 constexpr char kNonCallableEntity[] = "No action associated with the entity";
 
-std::vector<std::string> split(std::string const &input, char delim)
+constexpr char kLazyField[] = "lazy"; // Resolution field of lazy timers.
+constexpr char kMissingField[] = "State string is missing a field";
+constexpr char kInvalidNumber[] = "State string field is not a number";
+
+/**
+ * @brief Fields of a state string, as views to the original string.
+ *
+ * @details Parsing does not allocate. Fields beyond the maximum supported
+ * count are ignored, an empty trailing field is dropped.
+ */
+class Fields
 {
-    thread_local std::stringstream ss;
+    static constexpr std::size_t kMaxFields = 16;
 
-    ss.clear(); // Clear error state - invocations stop with eofbit.
-    ss.str(input);
+    std::array<std::string_view, kMaxFields> _items;
+    std::size_t _size = 0;
 
-    std::string item;
-    std::vector<std::string> ret;
-    while (std::getline(ss, item, delim))
+  public:
+    Fields(std::string_view input, char delim)
     {
-        ret.emplace_back(std::move(item));
+        while (!input.empty() && _size < kMaxFields)
+        {
+            auto const pos = input.find(delim);
+            _items[_size++] = input.substr(0, pos);
+            input.remove_prefix(std::string_view::npos == pos ? input.size()
+                                                              : pos + 1);
+        }
     }
 
-    return ret;
+    std::string_view at(std::size_t i) const
+    {
+        if (i >= _size)
+        {
+            throw std::out_of_range(kMissingField);
+        }
+        return _items[i];
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+};
+
+// Append the decimal representation of a number.
+template <class Int> void appendNumber(std::string &out, Int value)
+{
+    char buf[24];
+    auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), value);
+    out.append(buf, end);
+}
+
+template <class Int> Int number_from(std::string_view s)
+{
+    Int value = 0;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc{})
+    {
+        throw std::invalid_argument(kInvalidNumber);
+    }
+    return value;
+}
+
+std::chrono::milliseconds millis_from(std::string_view s)
+{
+    return std::chrono::milliseconds(
+        number_from<std::chrono::milliseconds::rep>(s));
+}
+
+std::chrono::system_clock::time_point time_point_from(std::int64_t millis)
+{
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::milliseconds(millis)));
 }
 
-template <class Rep, class Period>
-std::string to_string(std::chrono::duration<Rep, Period> const &d)
+std::int64_t millis_since_epoch(std::chrono::system_clock::time_point t)
 {
-    return std::to_string(d.count());
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               t.time_since_epoch())
+        .count();
 }
 
-std::chrono::milliseconds millis_from(std::string const &s)
+// Clock of timer deadlines, the one the scheduler runs on.
+using timer_clock_t = std::chrono::steady_clock;
+
+// Time left until a deadline, given in clock ticks, rounded up to whole
+// milliseconds.
+std::chrono::milliseconds millis_until(timer_clock_t::rep deadline,
+                                       timer_clock_t::time_point now)
 {
-    return std::chrono::milliseconds(std::stoul(s));
+    auto const left =
+        timer_clock_t::time_point(timer_clock_t::duration(deadline)) - now;
+    return std::max(std::chrono::ceil<std::chrono::milliseconds>(left), 0ms);
 }
 
 #if 0
@@ -80,287 +158,2111 @@ auto stich(char delimiter, std::string const &arg, Args &&...args)
     ret.reserve((arg.size() + ... + std::size(args)));
     ((ret += arg), ..., (ret += delimiter, ret += args));
 
-    return ret;
-}
+    return ret;
+}
+
+/**
+ * @brief Countdown with a callback.
+ *
+ * @details Timers with a resolution tick every resolution step, subtracting
+ * it from the remaining time. Lazy timers, created with kLazyResolution and
+ * flagged as such in serialized states, only run on expiry: while counting
+ * down they keep a deadline and compute the remaining time from it, so they
+ * neither wake up in between nor drift when the scheduler runs late.
+ */
+class TimerEntity
+{
+    ttt::TimerState _state;
+    std::function<void(ttt::TimerState const &)> _onTick;
+    // Deadline of a lazy timer that counts down, in clock ticks. Zero while
+    // the timer is paused or stopped.
+    std::atomic<timer_clock_t::rep> _deadline{0};
+
+  public:
+    TimerEntity(std::string_view state)
+        : TimerEntity(Fields(state, kElementFieldsDelimiter))
+    {
+    }
+    // The group is an optional trailing field. Lazy timers have the
+    // kLazyField in place of their resolution.
+    TimerEntity(Fields const &args)
+        : TimerEntity(std::string(args.at(1)),
+                      kLazyField == args.at(2) ? ttt::kLazyResolution
+                                               : millis_from(args.at(2)),
+                      millis_from(args.at(3)), millis_from(args.at(4)),
+                      args.at(5) == "1" ? true : false,
+                      args.size() > 7 ? std::string(args.at(7)) : std::string(),
+                      kLazyField == args.at(2))
+    {
+    }
+    TimerEntity(ttt::detail::TimerRecord const &rec)
+        : TimerEntity(std::string(rec.name),
+                      std::chrono::milliseconds(rec.resolution),
+                      std::chrono::milliseconds(rec.duration),
+                      std::chrono::milliseconds(rec.remaining), rec.repeating,
+                      std::string(rec.group), rec.lazy)
+    {
+    }
+    TimerEntity(std::string const &name, std::chrono::milliseconds resolution,
+                std::chrono::milliseconds duration,
+                std::chrono::milliseconds remaining, bool repeating,
+                std::string group, bool lazy)
+        : _state{name,      resolution,       duration, remaining,
+                 repeating, std::move(group), lazy}
+    {
+        // A zero resolution is never taken for laziness, e.g. when loaded.
+        if (lazy != (ttt::kLazyResolution == resolution))
+        {
+            throw std::runtime_error(kInvalidTimerResolution);
+        }
+    }
+
+    void setAction(std::function<void(ttt::TimerState const &)> action)
+    {
+        _onTick = std::move(action);
+    }
+
+    bool hasAction() const
+    {
+        return static_cast<bool>(_onTick);
+    }
+
+    void operator()()
+    {
+        if (_onTick)
+        {
+            _onTick(_state);
+        }
+        else
+        {
+            throw std::runtime_error(kNonCallableEntity);
+        }
+    }
+
+    // Append the state string of the timer, given a snapshot of its state.
+    // Only reads immutable members of the entity.
+    void appendTo(std::string &out, ttt::TimerSnapshot const &snap) const
+    {
+        out += kTimerElement;
+        out += kElementFieldsDelimiter;
+        out += _state.name;
+        out += kElementFieldsDelimiter;
+        if (snap.lazy)
+        {
+            out += kLazyField;
+        }
+        else
+        {
+            appendNumber(out, snap.resolution.count());
+        }
+        out += kElementFieldsDelimiter;
+        appendNumber(out, snap.duration.count());
+        out += kElementFieldsDelimiter;
+        appendNumber(out, snap.remaining.count());
+        out += kElementFieldsDelimiter;
+        out += snap.repeating ? '1' : '0';
+        out += kElementFieldsDelimiter;
+        out += snap.active ? '1' : '0';
+        if (!_state.group.empty())
+        {
+            out += kElementFieldsDelimiter;
+            out += _state.group;
+        }
+    }
+
+    // As appendTo, the record refers to immutable members only.
+    ttt::detail::TimerRecord toRecord(ttt::TimerSnapshot const &snap) const
+    {
+        return {.name = _state.name,
+                .resolution = snap.resolution.count(),
+                .duration = snap.duration.count(),
+                .remaining = snap.remaining.count(),
+                .repeating = snap.repeating,
+                .active = snap.active,
+                .group = _state.group,
+                .lazy = snap.lazy};
+    }
+
+    // Remove a "resolution" from remaining. Returns whether it can tick again.
+    // The new value is stored once, so readers never observe the zero of a
+    // repeating timer.
+    bool tick()
+    {
+        if (lazy())
+        {
+            return expire();
+        }
+
+        auto const remaining = _state.remaining.load();
+        if (0 == remaining.count())
+        {
+            throw std::runtime_error(kInvalidTimerCountdown);
+        }
+
+        auto next = remaining - _state.resolution;
+        bool const expired = 0 == next.count();
+        if (expired && _state.repeating)
+        {
+            // Repeating clocks re-start from "duration".
+            next = _state.duration;
+        }
+        _state.remaining.store(next);
+
+        return !expired || _state.repeating;
+    }
+
+    void reset(bool addStep)
+    {
+        _deadline = 0;
+        _state.remaining =
+            _state.duration + (addStep ? _state.resolution : 0ms);
+    }
+
+    bool lazy() const
+    {
+        return _state.lazy;
+    }
+
+    // Remaining time, computed from the deadline of a counting lazy timer.
+    std::chrono::milliseconds remaining() const
+    {
+        auto const deadline = _deadline.load();
+        return deadline ? millis_until(deadline, timer_clock_t::now())
+                        : _state.remaining.load();
+    }
+
+    timer_clock_t::rep deadline() const
+    {
+        return _deadline;
+    }
+
+    ttt::TimerSnapshot snapshot(bool active) const
+    {
+        return {.resolution = _state.resolution,
+                .duration = _state.duration,
+                .remaining = remaining(),
+                .repeating = _state.repeating,
+                .active = active,
+                .lazy = _state.lazy};
+    }
+
+    // Lazy timers count down from now on. Expects no pending invocation.
+    void start()
+    {
+        if (lazy())
+        {
+            _deadline =
+                (timer_clock_t::now() + _state.remaining.load())
+                    .time_since_epoch()
+                    .count();
+        }
+    }
+
+    ttt::TimerState const &state() const
+    {
+        return _state;
+    }
+
+    // Freezes the remaining time of a lazy timer. Expects no pending
+    // invocation.
+    void halt()
+    {
+        if (auto const deadline = _deadline.exchange(0))
+        {
+            _state.remaining = millis_until(deadline, timer_clock_t::now());
+        }
+    }
+
+  private:
+    // Invocation of a lazy timer. Runs before the deadline only if the timer
+    // was scheduled to run immediately. Returns whether it can expire again.
+    bool expire()
+    {
+        auto const now = timer_clock_t::now();
+        auto deadline = _deadline.load();
+        bool ret = true;
+
+        if (now >= timer_clock_t::time_point(timer_clock_t::duration(deadline)))
+        {
+            if (_state.repeating)
+            {
+                // Counted from the previous deadline, to not accumulate the
+                // lateness of invocations.
+                deadline += std::chrono::duration_cast<timer_clock_t::duration>(
+                                _state.duration)
+                                .count();
+                _deadline = deadline;
+            }
+            ret = _state.repeating;
+        }
+        _state.remaining = millis_until(deadline, now);
+
+        return ret;
+    }
+};
+
+class PulseEntity
+{
+    ttt::PulseState _state;
+    std::function<void(ttt::PulseState const &)> _onBeat;
+    // Whether a gap before the next beat counts as missed beats. Unset on
+    // resumption, since paused pulses are not expected to beat.
+    bool _countMisses = true;
+
+  public:
+    PulseEntity(Fields const &args)
+        : PulseEntity(std::string(args.at(1)), millis_from(args.at(2)),
+                      time_point_from(number_from<std::int64_t>(args.at(3))),
+                      number_from<std::uint64_t>(args.at(4)),
+                      number_from<std::uint64_t>(args.at(5)))
+    {
+    }
+    PulseEntity(ttt::detail::PulseRecord const &rec)
+        : PulseEntity(std::string(rec.name),
+                      std::chrono::milliseconds(rec.period),
+                      time_point_from(rec.lastBeat), rec.beats, rec.missed)
+    {
+    }
+    PulseEntity(std::string const &name, std::chrono::milliseconds period,
+                std::chrono::system_clock::time_point lastBeat,
+                std::uint64_t beats, std::uint64_t missed)
+        : _state{name, period, lastBeat, beats, missed}
+    {
+    }
+
+    void setAction(std::function<void(ttt::PulseState const &)> action)
+    {
+        _onBeat = std::move(action);
+    }
+
+    void skipMisses()
+    {
+        _countMisses = false;
+    }
+
+    // Record a beat and call the associated action, if any.
+    void beat()
+    {
+        auto const now = std::chrono::system_clock::now();
+        auto const last = _state.lastBeat.load();
+
+        if (_countMisses && last.time_since_epoch().count())
+        {
+            if (auto const nPeriods = (now - last) / _state.period;
+                nPeriods > 1)
+            {
+                _state.missed += static_cast<std::uint64_t>(nPeriods - 1);
+            }
+        }
+        _countMisses = true;
+
+        _state.lastBeat = now;
+        ++_state.beats;
+
+        if (_onBeat)
+        {
+            _onBeat(_state);
+        }
+    }
+
+    // Append the state string of the pulse, given its activity.
+    void appendTo(std::string &out, bool active) const
+    {
+        out += kPulseElement;
+        out += kElementFieldsDelimiter;
+        out += _state.name;
+        out += kElementFieldsDelimiter;
+        appendNumber(out, _state.period.count());
+        out += kElementFieldsDelimiter;
+        appendNumber(out, millis_since_epoch(_state.lastBeat));
+        out += kElementFieldsDelimiter;
+        appendNumber(out, _state.beats.load());
+        out += kElementFieldsDelimiter;
+        appendNumber(out, _state.missed.load());
+        out += kElementFieldsDelimiter;
+        out += active ? '1' : '0';
+    }
+
+    ttt::detail::PulseRecord toRecord(bool active) const
+    {
+        return {.name = _state.name,
+                .period = _state.period.count(),
+                .lastBeat = millis_since_epoch(_state.lastBeat),
+                .beats = _state.beats,
+                .missed = _state.missed,
+                .active = active};
+    }
+
+    ttt::PulseStatus status(bool active) const
+    {
+        return {.lastBeat = _state.lastBeat,
+                .beats = _state.beats,
+                .missed = _state.missed,
+                .active = active};
+    }
+
+    ttt::PulseState const &state() const
+    {
+        return _state;
+    }
+};
+
+class AlarmEntity
+{
+    ttt::AlarmState _state;
+    std::function<void(ttt::AlarmState const &)> _onFire;
+
+  public:
+    AlarmEntity(Fields const &args)
+        : AlarmEntity(std::string(args.at(1)),
+                      time_point_from(number_from<std::int64_t>(args.at(2))))
+    {
+    }
+    AlarmEntity(ttt::detail::AlarmRecord const &rec)
+        : AlarmEntity(std::string(rec.name), time_point_from(rec.deadline))
+    {
+    }
+    AlarmEntity(std::string const &name,
+                std::chrono::system_clock::time_point deadline)
+        : _state{name, deadline}
+    {
+    }
+
+    void setAction(std::function<void(ttt::AlarmState const &)> action)
+    {
+        _onFire = std::move(action);
+    }
+
+    void fire() const
+    {
+        if (_onFire)
+        {
+            _onFire(_state);
+        }
+    }
+
+    // Append the state string of the alarm.
+    void appendTo(std::string &out) const
+    {
+        out += kAlarmElement;
+        out += kElementFieldsDelimiter;
+        out += _state.name;
+        out += kElementFieldsDelimiter;
+        appendNumber(out, millis_since_epoch(_state.deadline));
+    }
+
+    ttt::detail::AlarmRecord toRecord() const
+    {
+        return {.name = _state.name,
+                .deadline = millis_since_epoch(_state.deadline)};
+    }
+
+    ttt::AlarmState const &state() const
+    {
+        return _state;
+    }
+};
+
+// Stable reference to an element of a SlotArray.
+struct Handle
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+};
+
+/**
+ * @brief Storage of elements in contiguous slots, addressed by stable handles.
+ *
+ * @details Slots live in fixed size chunks, hence element addresses remain
+ * valid while the array grows. Freed slots are recycled and their generation
+ * is bumped, so that handles to removed elements are detected.
+ */
+template <class T> class SlotArray
+{
+    static constexpr std::size_t kChunkSize = 1024;
+
+    struct Slot
+    {
+        std::optional<T> value;
+        std::uint32_t generation = 0;
+        bool retired = false; // Removed, but not destroyed yet.
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> _chunks;
+    std::vector<std::uint32_t> _free;
+    std::uint32_t _used = 0; // High watermark of slot usage.
+    std::size_t _size = 0;
+
+    Slot &slot(std::uint32_t index) const
+    {
+        return _chunks[index / kChunkSize][index % kChunkSize];
+    }
+
+  public:
+    template <class... Args> Handle emplace(Args &&...args)
+    {
+        std::uint32_t index;
+        if (_free.empty())
+        {
+            if (_used == _chunks.size() * kChunkSize)
+            {
+                _chunks.emplace_back(std::make_unique<Slot[]>(kChunkSize));
+            }
+            index = _used++;
+        }
+        else
+        {
+            index = _free.back();
+            _free.pop_back();
+        }
+
+        auto &s = slot(index);
+        s.value.emplace(std::forward<Args>(args)...);
+        ++_size;
+
+        return {index, s.generation};
+    }
+
+    void erase(Handle h)
+    {
+        if (get(h))
+        {
+            retire(h);
+            release(h.index);
+        }
+    }
+
+    // Removes the element, keeping it alive until released. The slot is not
+    // reused in between.
+    void retire(Handle h)
+    {
+        if (get(h))
+        {
+            auto &s = slot(h.index);
+            s.retired = true;
+            ++s.generation;
+            --_size;
+        }
+    }
+
+    void release(std::uint32_t index)
+    {
+        auto &s = slot(index);
+        s.value.reset();
+        s.retired = false;
+        _free.push_back(index);
+    }
+
+    T *get(Handle h) const
+    {
+        T *ret = nullptr;
+
+        if (h.index < _used)
+        {
+            auto &s = slot(h.index);
+            if (s.generation == h.generation && s.value && !s.retired)
+            {
+                ret = &*s.value;
+            }
+        }
+
+        return ret;
+    }
+
+    template <class F> void forEach(F &&fun) const
+    {
+        for (std::uint32_t i = 0; i < _used; ++i)
+        {
+            if (auto &s = slot(i); s.value && !s.retired)
+            {
+                fun(*s.value);
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+};
+
+/**
+ * @brief Timer states readable without locking, indexed as the timer slots.
+ *
+ * @details Every cell is a seqlock: writers make the sequence odd while
+ * updating, readers retry if the sequence was odd or changed while copying.
+ * Writers are the tick of a timer and changes made under the timeline lock,
+ * serialized by the sequence itself. Chunks are never freed while the board
+ * exists and the chunk table is replaced as a whole when growing, so readers
+ * need no lock to reach a cell. Replaced tables are kept, since readers may
+ * still be walking them.
+ * Exports see the timers of a point in time, an epoch: cells record the
+ * epochs their timer was added and removed in, and the cells of timers
+ * removed during an export are kept intact until it finishes.
+ */
+class SnapshotBoard
+{
+    static constexpr std::size_t kChunkSize = 1024;
+    static constexpr std::uint64_t kLive =
+        std::numeric_limits<std::uint64_t>::max();
+
+    struct Cell
+    {
+        std::atomic<std::uint32_t> seq{0};
+        std::atomic<std::uint32_t> generation{0};
+        std::atomic<bool> live{false};
+        std::atomic<bool> active{false};
+        std::atomic<bool> repeating{false};
+        std::atomic<bool> lazy{false};
+        std::atomic<std::int64_t> resolution{0};
+        std::atomic<std::int64_t> duration{0};
+        std::atomic<std::int64_t> remaining{0};
+        std::atomic<timer_clock_t::rep> deadline{0}; // Of lazy timers.
+        // Not part of the snapshot, read along with it by exports.
+        std::atomic<TimerEntity const *> entity{nullptr};
+        std::atomic<std::uint64_t> born{0};
+        std::atomic<std::uint64_t> died{kLive};
+    };
+
+    // Consistent copy of a cell.
+    struct View
+    {
+        std::uint32_t generation;
+        TimerEntity const *entity;
+        std::uint64_t born;
+        std::uint64_t died;
+        bool live;
+        ttt::TimerSnapshot snap;
+    };
+
+    std::vector<std::unique_ptr<Cell[]>> _chunks;
+    std::vector<std::unique_ptr<Cell *[]>> _tables;
+    std::atomic<Cell *const *> _table{nullptr};
+    std::atomic<std::size_t> _nChunks{0};
+    std::atomic<std::uint32_t> _used{0}; // High watermark of published cells.
+    // Exports started so far. Guarded by the timeline lock.
+    mutable std::uint64_t _epoch = 0;
+
+    Cell &cell(std::uint32_t index) const
+    {
+        auto const table = _table.load(std::memory_order_acquire);
+        return table[index / kChunkSize][index % kChunkSize];
+    }
+
+    // Runs update on the cell, excluding readers and other writers.
+    template <class F> void write(std::uint32_t index, F &&update)
+    {
+        auto &c = cell(index);
+        auto seq = c.seq.load(std::memory_order_relaxed);
+        do
+        {
+            while (seq & 1u)
+            {
+                seq = c.seq.load(std::memory_order_relaxed);
+            }
+        } while (!c.seq.compare_exchange_weak(seq, seq + 1,
+                                              std::memory_order_acquire,
+                                              std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_release);
+
+        update(c);
+
+        c.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    static View read(Cell const &c, timer_clock_t::time_point now)
+    {
+        using millis = std::chrono::milliseconds;
+        constexpr auto relaxed = std::memory_order_relaxed;
+        std::uint32_t seq;
+        timer_clock_t::rep deadline;
+        View ret;
+
+        do
+        {
+            seq = c.seq.load(std::memory_order_acquire);
+            ret.generation = c.generation.load(relaxed);
+            ret.entity = c.entity.load(relaxed);
+            ret.born = c.born.load(relaxed);
+            ret.died = c.died.load(relaxed);
+            ret.live = c.live.load(relaxed);
+            ret.snap.resolution = millis(c.resolution.load(relaxed));
+            ret.snap.duration = millis(c.duration.load(relaxed));
+            ret.snap.remaining = millis(c.remaining.load(relaxed));
+            ret.snap.repeating = c.repeating.load(relaxed);
+            ret.snap.active = c.active.load(relaxed);
+            ret.snap.lazy = c.lazy.load(relaxed);
+            deadline = c.deadline.load(relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1u) || seq != c.seq.load(relaxed));
+
+        if (deadline)
+        {
+            ret.snap.remaining = millis_until(deadline, now);
+        }
+
+        return ret;
+    }
+
+    // Calls fun(index, view) for every published cell.
+    template <class F> void walk(F &&fun) const
+    {
+        auto const used = _used.load(std::memory_order_acquire);
+        auto const now = timer_clock_t::now();
+        for (std::uint32_t i = 0; i < used; ++i)
+        {
+            fun(i, read(cell(i), now));
+        }
+    }
+
+  public:
+    // Makes the state of a new timer visible. Expects the timeline lock.
+    void publish(Handle h, TimerEntity const &entity, bool active)
+    {
+        auto const nChunks = _nChunks.load(std::memory_order_relaxed);
+        if (h.index >= nChunks * kChunkSize)
+        {
+            _chunks.emplace_back(std::make_unique<Cell[]>(kChunkSize));
+
+            auto table = std::make_unique<Cell *[]>(nChunks + 1);
+            for (std::size_t i = 0; i <= nChunks; ++i)
+            {
+                table[i] = _chunks[i].get();
+            }
+            _table.store(table.get(), std::memory_order_release);
+            _nChunks.store(nChunks + 1, std::memory_order_release);
+            _tables.push_back(std::move(table));
+        }
+
+        write(h.index, [&](Cell &c) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            auto const &state = entity.state();
+            c.entity.store(&entity, relaxed);
+            c.born.store(_epoch, relaxed);
+            c.died.store(kLive, relaxed);
+            c.generation.store(h.generation, relaxed);
+            c.live.store(true, relaxed);
+            c.active.store(active, relaxed);
+            c.repeating.store(state.repeating, relaxed);
+            c.lazy.store(state.lazy, relaxed);
+            c.resolution.store(state.resolution.count(), relaxed);
+            c.duration.store(state.duration.count(), relaxed);
+            c.remaining.store(state.remaining.load().count(), relaxed);
+            c.deadline.store(entity.deadline(), relaxed);
+        });
+
+        if (h.index >= _used.load(std::memory_order_relaxed))
+        {
+            _used.store(h.index + 1, std::memory_order_release);
+        }
+    }
+
+    void update(std::uint32_t index, TimerEntity const &entity)
+    {
+        write(index, [&entity](Cell &c) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            c.remaining.store(entity.state().remaining.load().count(), relaxed);
+            c.deadline.store(entity.deadline(), relaxed);
+        });
+    }
+
+    void update(std::uint32_t index, TimerEntity const &entity, bool active)
+    {
+        write(index, [&entity, active](Cell &c) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            c.remaining.store(entity.state().remaining.load().count(), relaxed);
+            c.deadline.store(entity.deadline(), relaxed);
+            c.active.store(active, relaxed);
+        });
+    }
+
+    // Expects the timeline lock.
+    void retire(std::uint32_t index)
+    {
+        write(index, [this](Cell &c) {
+            c.live.store(false, std::memory_order_relaxed);
+            c.died.store(_epoch, std::memory_order_relaxed);
+        });
+    }
+
+    std::optional<ttt::TimerSnapshot> get(Handle h) const
+    {
+        std::optional<ttt::TimerSnapshot> ret;
+
+        if (h.index < _used.load(std::memory_order_acquire))
+        {
+            if (auto const view = read(cell(h.index), timer_clock_t::now());
+                view.live && view.generation == h.generation)
+            {
+                ret = view.snap;
+            }
+        }
+
+        return ret;
+    }
+
+    template <class F> void forEach(F &&fun) const
+    {
+        walk([&fun](std::uint32_t index, View const &view) {
+            if (view.live)
+            {
+                fun(ttt::TimerHandle{index, view.generation}, view.snap);
+            }
+        });
+    }
+
+    // Upper bound of the number of timers, readable without locking.
+    std::size_t watermark() const
+    {
+        return _used.load(std::memory_order_acquire);
+    }
+
+    // Starts the epoch of an export. Expects the timeline lock.
+    std::uint64_t pin() const
+    {
+        return ++_epoch;
+    }
+
+    // Visits the entity and state of the timers that existed when the epoch
+    // started, without the timeline lock. Timers removed since then are
+    // visited with their last state. Expects removed timers to be kept from
+    // destruction while an export runs.
+    template <class F> void forEachEntity(std::uint64_t epoch, F &&fun) const
+    {
+        walk([epoch, &fun](std::uint32_t, View const &view) {
+            if (view.born < epoch && view.died >= epoch)
+            {
+                fun(*view.entity, view.snap);
+            }
+        });
+    }
+};
+
+/**
+ * @brief Collects timer ticks, delivering them in batches.
+ *
+ * @details Ticks are appended to a pending batch, which a scheduler task
+ * hands to the subscriber once per delivery window. Batches are delivered on
+ * the scheduler executor, or through a bounded worker queue that drops the
+ * oldest batches rather than stalling the scheduler on a slow subscriber.
+ */
+class TickBatcher
+{
+    std::mutex _mtx;
+    std::vector<ttt::TimerTick> _pending;
+    std::atomic_bool _enabled{false};
+    std::function<void(std::span<const ttt::TimerTick>)> _onBatch;
+    std::optional<ttt::CallToken> _flushTask;
+    // Declared last, so that queued batches are dropped before the
+    // subscriber is destroyed.
+    std::unique_ptr<ttt::BufferedWorker<std::function<void()>>> _worker;
+
+  public:
+    ~TickBatcher()
+    {
+        _flushTask.reset();
+    }
+
+    void configure(ttt::CallScheduler &scheduler,
+                   std::chrono::milliseconds window,
+                   std::function<void(std::span<const ttt::TimerTick>)> onBatch,
+                   std::size_t maxQueued)
+    {
+        stop();
+        if (!onBatch)
+        {
+            return;
+        }
+
+        _onBatch = std::move(onBatch);
+        if (maxQueued)
+        {
+            _worker = std::make_unique<
+                ttt::BufferedWorker<std::function<void()>>>(maxQueued);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _enabled = true;
+        }
+        _flushTask.emplace(scheduler.add(
+            [this] {
+                flush();
+                return ttt::Result::Repeat;
+            },
+            window));
+    }
+
+    void push(TimerEntity const &entity)
+    {
+        if (!_enabled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        ttt::TimerTick tick{entity.state().name, entity.snapshot(true)};
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (_enabled)
+        {
+            _pending.push_back(std::move(tick));
+        }
+    }
+
+  private:
+    // Delivers pending ticks, then stops batching.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _enabled = false;
+        }
+        _flushTask.reset(); // Waits for a running flush.
+        flush();
+        if (_worker)
+        {
+            _worker->drain();
+            _worker.reset();
+        }
+        _onBatch = nullptr;
+    }
+
+    void flush()
+    {
+        std::vector<ttt::TimerTick> batch;
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (_pending.empty())
+            {
+                return;
+            }
+            batch.swap(_pending);
+            _pending.reserve(batch.size());
+        }
+
+        if (_worker)
+        {
+            _worker->add([this, batch = std::move(batch)] { _onBatch(batch); });
+        }
+        else
+        {
+            _onBatch(batch);
+        }
+    }
+};
+
+struct TimerEntry
+{
+    TimerEntity entity;
+    // Declared after the entity, since it is the token that keeps scheduled
+    // callbacks from accessing a destroyed entity.
+    std::optional<ttt::CallToken> token;
+    std::uint32_t groupPos = 0;           // Position in the group's members.
+    Handle handle{};                      // Slot of the entry, as published.
+    ttt::LaneId lane = ttt::kDefaultLane; // Executors running the ticks.
+
+    template <class... Args>
+    explicit TimerEntry(Args &&...args) : entity(std::forward<Args>(args)...)
+    {
+    }
+};
+
+struct AlarmEntry
+{
+    AlarmEntity entity;
+
+    template <class... Args>
+    explicit AlarmEntry(Args &&...args) : entity(std::forward<Args>(args)...)
+    {
+    }
+};
+
+struct PulseEntry
+{
+    PulseEntity entity;
+    // Declared after the entity, as in TimerEntry.
+    std::optional<ttt::CallToken> token;
+
+    template <class... Args>
+    explicit PulseEntry(Args &&...args) : entity(std::forward<Args>(args)...)
+    {
+    }
+};
+
+/**
+ * @brief Entities stored in slots and indexed by name.
+ *
+ * @details Names are stored once, in the entity state. The index keys are
+ * views of those strings, which remain valid since slots never move. Entries
+ * with a group position are also listed under their group, if any.
+ */
+template <class Entry> class EntityStore
+{
+    static constexpr bool kGrouped = requires(Entry &e) { e.groupPos; };
+
+    SlotArray<Entry> _slots;
+    std::unordered_map<std::string_view, Handle> _index;
+    std::unordered_map<std::string, std::vector<Handle>> _groups;
+
+  public:
+    // Returns the newly added entry, or null if the name is already in use.
+    template <class... Args>
+    Entry *emplace(std::string_view name, Args &&...args)
+    {
+        auto h = add(name, std::forward<Args>(args)...);
+        return h ? _slots.get(*h) : nullptr;
+    }
+
+    // As emplace, returning the handle of the entry.
+    template <class... Args>
+    std::optional<Handle> add(std::string_view name, Args &&...args)
+    {
+        std::optional<Handle> ret;
+
+        if (!_index.contains(name))
+        {
+            auto h = _slots.emplace(std::forward<Args>(args)...);
+            ret = h;
+            auto *entry = _slots.get(h);
+            _index.emplace(entry->entity.state().name, h);
+
+            if constexpr (kGrouped)
+            {
+                if (auto const &group = entry->entity.state().group;
+                    !group.empty())
+                {
+                    auto &members = _groups[group];
+                    entry->groupPos =
+                        static_cast<std::uint32_t>(members.size());
+                    members.push_back(h);
+                }
+            }
+        }
+
+        return ret;
+    }
+
+    Entry *find(std::string_view name) const
+    {
+        auto it = _index.find(name);
+        return _index.end() != it ? _slots.get(it->second) : nullptr;
+    }
+
+    std::optional<Handle> handle(std::string_view name) const
+    {
+        std::optional<Handle> ret;
+        if (auto it = _index.find(name); _index.end() != it)
+        {
+            ret = it->second;
+        }
+        return ret;
+    }
+
+    // Null if the entry was removed.
+    Entry *get(Handle h) const
+    {
+        return _slots.get(h);
+    }
+
+    // Removes the entry, handing it over to the caller.
+    std::optional<Entry> extract(Handle h)
+    {
+        std::optional<Entry> ret;
+
+        if (auto *entry = _slots.get(h))
+        {
+            _index.erase(std::string_view(entry->entity.state().name));
+            leaveGroup(*entry);
+            ret.emplace(std::move(*entry));
+            _slots.erase(h);
+        }
+
+        return ret;
+    }
+
+    bool erase(std::string_view name)
+    {
+        bool ret = false;
+
+        if (auto it = _index.find(name); _index.end() != it)
+        {
+            auto h = it->second;
+            _index.erase(it); // Erase the view before the viewed string.
+            leaveGroup(*_slots.get(h));
+            _slots.erase(h);
+            ret = true;
+        }
+
+        return ret;
+    }
+
+    // As erase, keeping the entry alive until released.
+    void retire(Handle h)
+    {
+        if (auto *entry = _slots.get(h))
+        {
+            _index.erase(std::string_view(entry->entity.state().name));
+            leaveGroup(*entry);
+            _slots.retire(h);
+        }
+    }
+
+    void release(std::uint32_t index)
+    {
+        _slots.release(index);
+    }
+
+    template <class F> void forEach(F &&fun) const
+    {
+        _slots.forEach(std::forward<F>(fun));
+    }
+
+    template <class F> void forEachIn(std::string const &group, F &&fun) const
+    {
+        if (auto it = _groups.find(group); _groups.end() != it)
+        {
+            for (auto h : it->second)
+            {
+                fun(*_slots.get(h));
+            }
+        }
+    }
+
+    std::size_t size() const
+    {
+        return _slots.size();
+    }
+
+    // Avoids rehashing the index while loading many timers.
+    void reserve(std::size_t n)
+    {
+        _index.reserve(n);
+    }
+
+  private:
+    // Swaps the last member of the group into the position of the entry.
+    void leaveGroup(Entry const &entry)
+    {
+        if constexpr (kGrouped)
+        {
+            auto const &group = entry.entity.state().group;
+            if (group.empty())
+            {
+                return;
+            }
+
+            auto it = _groups.find(group);
+            auto &members = it->second;
+            auto const last = members.back();
+            members[entry.groupPos] = last;
+            _slots.get(last)->groupPos = entry.groupPos;
+            members.pop_back();
+
+            if (members.empty())
+            {
+                _groups.erase(it);
+            }
+        }
+    }
+};
+
+/**
+ * @brief One-shot alarms ordered by deadline.
+ *
+ * @details Deadlines are kept in a min-heap. Removing an alarm only frees its
+ * slot, which leaves a stale heap entry to be skipped when popped. A single
+ * scheduler task, the pump, fires all due alarms in one batch and re-arms
+ * for the next deadline. A pump moved earlier replaces the pending one, which
+ * is cancelled, as is the pending pump once the queue is closed.
+ */
+class AlarmQueue : public std::enable_shared_from_this<AlarmQueue>
+{
+    using clock_t = std::chrono::system_clock;
+
+    struct Pending
+    {
+        clock_t::time_point deadline;
+        Handle handle;
+    };
+
+    // Heap algorithms build max-heaps, so order by later deadline.
+    static bool later(Pending const &a, Pending const &b)
+    {
+        return a.deadline > b.deadline;
+    }
+
+    mutable std::mutex _mtx;
+    EntityStore<AlarmEntry> _alarms;
+    std::vector<Pending> _heap;
+    std::size_t _nStale = 0; // Heap entries of removed alarms.
+    // Deadline of the pending pump, or max if none is pending, its token and
+    // the number of pumps scheduled so far, identifying that pump.
+    clock_t::time_point _armedFor = clock_t::time_point::max();
+    std::optional<ttt::CallToken> _pump;
+    std::uint64_t _armings = 0;
+    ttt::CallScheduler *_schedule;
+    bool _closed = false;
+
+  public:
+    explicit AlarmQueue(ttt::CallScheduler *scheduler) : _schedule(scheduler)
+    {
+    }
+
+    template <class... Args>
+    bool add(std::string_view name,
+             std::function<void(ttt::AlarmState const &)> onFire,
+             Args &&...args)
+    {
+        std::optional<ttt::CallToken> replaced; // Cancelled after unlocking.
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto h = _alarms.add(name, std::forward<Args>(args)...);
+
+        if (h)
+        {
+            auto &entity = _alarms.get(*h)->entity;
+            entity.setAction(std::move(onFire));
+
+            _heap.push_back({entity.state().deadline, *h});
+            std::push_heap(_heap.begin(), _heap.end(), later);
+            arm(entity.state().deadline, replaced);
+        }
+
+        return h.has_value();
+    }
+
+    bool remove(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        bool const ret = _alarms.erase(name);
+
+        if (ret && ++_nStale > _heap.size() / 2)
+        {
+            std::erase_if(_heap, [this](Pending const &p) {
+                return nullptr == _alarms.get(p.handle);
+            });
+            std::make_heap(_heap.begin(), _heap.end(), later);
+            _nStale = 0;
+        }
+
+        return ret;
+    }
+
+    template <class F> void forEach(F &&fun) const
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _alarms.forEach(std::forward<F>(fun));
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _alarms.size();
+    }
+
+    // Stops pumping and drops all alarms. Invoked before the scheduler may
+    // be destroyed, while a running pump keeps the queue alive.
+    void close()
+    {
+        std::optional<ttt::CallToken> pump;
+        std::lock_guard<std::mutex> lock(_mtx);
+        _closed = true;
+        _alarms = {};
+        _heap = {};
+        if (_pump)
+        {
+            pump.emplace(std::move(*_pump));
+            _pump.reset();
+        }
+    }
+
+  private:
+    // Schedules the pump, unless it is pending and due no later. Overdue
+    // deadlines count as due now, so that they share a single pump whatever
+    // order they are added in. A pump moved earlier is replaced, its token
+    // handed to the caller to cancel after unlocking, since cancellation waits
+    // for a running pump. Expects the lock.
+    void arm(clock_t::time_point deadline,
+             std::optional<ttt::CallToken> &replaced)
+    {
+        auto const now = clock_t::now();
+        deadline = std::max(deadline, now);
+        if (_closed || deadline >= _armedFor)
+        {
+            return;
+        }
+        _armedFor = deadline;
+
+        // Rounded up, so that the pump does not run before its deadline.
+        using std::chrono::microseconds;
+        auto const delay = std::chrono::ceil<microseconds>(deadline - now);
+        auto token = _schedule->add(
+            [weak = weak_from_this(), arming = ++_armings] {
+                if (auto self = weak.lock())
+                {
+                    self->pump(arming);
+                }
+                return ttt::Result::Finished;
+            },
+            delay, delay.count() <= 0);
+
+        if (_pump)
+        {
+            replaced.emplace(std::move(*_pump));
+        }
+        _pump.emplace(std::move(token));
+    }
+
+    // Fires due alarms. The pending pump always gives up its place, even if
+    // the system clock was stepped back and it runs early, so that re-arming
+    // is not blocked by itself.
+    void pump(std::uint64_t arming)
+    {
+        std::vector<AlarmEntry> due;
+        std::optional<ttt::CallToken> replaced; // Cancelled after unlocking.
+
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            if (_closed)
+            {
+                return;
+            }
+
+            auto const now = clock_t::now();
+            if (_armings == arming && _pump)
+            {
+                _armedFor = clock_t::time_point::max(); // This pump.
+                _pump->detach();
+                _pump.reset();
+            }
+
+            while (!_heap.empty() && _heap.front().deadline <= now)
+            {
+                std::pop_heap(_heap.begin(), _heap.end(), later);
+                auto const h = _heap.back().handle;
+                _heap.pop_back();
+
+                if (auto entry = _alarms.extract(h))
+                {
+                    due.push_back(std::move(*entry));
+                }
+                else
+                {
+                    --_nStale;
+                }
+            }
+
+            // Re-armed before firing, so that a throwing action does not
+            // stop the pump.
+            if (!_heap.empty())
+            {
+                arm(_heap.front().deadline, replaced);
+            }
+        }
+
+        for (auto const &alarm : due)
+        {
+            alarm.entity.fire();
+        }
+    }
+};
+
+} // namespace
+
+namespace ttt
+{
+
+class TimelineImpl
+{
+    mutable std::mutex _mtx;
+    // Outlive the timer tasks that use them.
+    SnapshotBoard _board;
+    TickBatcher _batcher;
+    std::mutex _batchMtx; // Serializes batcher configuration.
+    EntityStore<TimerEntry> _timers;
+    EntityStore<PulseEntry> _pulses;
+    std::function<void(TimerChange, TimerState const &)> _observer;
+    std::function<void(TimerChange, TimerState const &)> _journal;
+    // Exports reading timers outside the lock, and the timers removed
+    // meanwhile, whose destruction is deferred until no export is running.
+    mutable std::size_t _exporters = 0;
+    std::vector<std::uint32_t> _graveyard;
+    std::shared_ptr<AlarmQueue> _alarms;
+    // Declared last: a privately owned scheduler is stopped before entities
+    // are destroyed, while a shared one outlives them.
+    std::shared_ptr<ttt::CallScheduler> _schedule;
+
+  public:
+    explicit TimelineImpl(std::shared_ptr<ttt::CallScheduler> scheduler)
+        : _schedule(scheduler ? std::move(scheduler)
+                              : std::make_shared<ttt::CallScheduler>())
+    {
+        _alarms = std::make_shared<AlarmQueue>(_schedule.get());
+    }
+
+    ~TimelineImpl()
+    {
+        _alarms->close();
+    }
+
+    TimelineImpl(std::vector<std::string> const &elements,
+                 std::function<void(ttt::TimerState const &)> timersEvent,
+                 std::shared_ptr<ttt::CallScheduler> scheduler,
+                 std::function<void(ttt::PulseState const &)> pulsesEvent,
+                 std::function<void(ttt::AlarmState const &)> alarmsEvent)
+        : TimelineImpl(std::move(scheduler))
+    {
+        _timers.reserve(elements.size());
+
+        for (auto const &el : elements)
+        {
+            Fields fields(el, kElementFieldsDelimiter);
+            auto const entityType = fields.at(0);
+
+            if (entityType == kTimerElement)
+            {
+                loadTimer(fields.at(1), "1" == fields.at(6), timersEvent,
+                          fields);
+            }
+            else if (entityType == kPulseElement)
+            {
+                loadPulse(fields.at(1), "1" == fields.at(6), pulsesEvent,
+                          fields);
+            }
+            else if (entityType == kAlarmElement)
+            {
+                _alarms->add(fields.at(1), alarmsEvent, fields);
+            }
+            else
+            {
+                throw std::runtime_error(kInvalidElementType);
+            }
+        }
+    }
+
+    TimelineImpl(std::span<const std::byte> image,
+                 std::function<void(ttt::TimerState const &)> timersEvent,
+                 std::shared_ptr<ttt::CallScheduler> scheduler,
+                 std::function<void(ttt::PulseState const &)> pulsesEvent,
+                 std::function<void(ttt::AlarmState const &)> alarmsEvent)
+        : TimelineImpl(std::move(scheduler))
+    {
+        ttt::detail::ImageReader reader(image);
+        _timers.reserve(reader.size());
+
+        struct
+        {
+            TimelineImpl *self;
+            std::function<void(ttt::TimerState const &)> const &onTick;
+            std::function<void(ttt::PulseState const &)> const &onBeat;
+            std::function<void(ttt::AlarmState const &)> const &onFire;
+
+            void operator()(ttt::detail::TimerRecord const &rec) const
+            {
+                self->loadTimer(rec.name, rec.active, onTick, rec);
+            }
+            void operator()(ttt::detail::PulseRecord const &rec) const
+            {
+                self->loadPulse(rec.name, rec.active, onBeat, rec);
+            }
+            void operator()(ttt::detail::AlarmRecord const &rec) const
+            {
+                self->_alarms->add(rec.name, onFire, rec);
+            }
+        } load{this, timersEvent, pulsesEvent, alarmsEvent};
+
+        while (reader.next(load))
+        {
+        }
+    }
+
+    // Timers are read from the snapshot board and formatted without the
+    // lock, so that exports do not block timer changes for their duration.
+    std::vector<std::string> serialize(bool timers, bool pulses,
+                                       bool alarms) const
+    {
+        std::vector<std::string> ret;
+        if (timers)
+        {
+            ExportPin pin(*this);
+            ret.reserve(_board.watermark());
+            _board.forEachEntity(pin.epoch, [&ret](TimerEntity const &entity,
+                                                   TimerSnapshot const &snap) {
+                entity.appendTo(ret.emplace_back(), snap);
+            });
+        }
+
+        if (pulses || alarms)
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            ret.reserve(ret.size() + (pulses ? _pulses.size() : 0) +
+                        (alarms ? _alarms->size() : 0));
+
+            if (pulses)
+            {
+                _pulses.forEach([&ret](PulseEntry const &pulseEntry) {
+                    pulseEntry.entity.appendTo(ret.emplace_back(),
+                                               pulseEntry.token.has_value());
+                });
+            }
+
+            if (alarms)
+            {
+                _alarms->forEach([&ret](AlarmEntry const &alarmEntry) {
+                    alarmEntry.entity.appendTo(ret.emplace_back());
+                });
+            }
+        }
+
+        return ret;
+    }
+
+    std::size_t serialize(std::vector<std::byte> &buffer, bool timers,
+                          bool pulses, bool alarms) const
+    {
+        auto const start = buffer.size();
+        {
+            ttt::detail::ImageWriter writer(buffer);
+
+            if (timers)
+            {
+                ExportPin pin(*this);
+                writer.reserve(_board.watermark() *
+                               (ttt::detail::ImageWriter::kTimerRecordSz + 16));
+                _board.forEachEntity(pin.epoch,
+                                     [&writer](TimerEntity const &entity,
+                                               TimerSnapshot const &snap) {
+                                         writer.write(entity.toRecord(snap));
+                                     });
+            }
+
+            if (pulses || alarms)
+            {
+                std::lock_guard<std::mutex> lock(_mtx);
+                if (pulses)
+                {
+                    writer.reserve(
+                        _pulses.size() *
+                        (ttt::detail::ImageWriter::kPulseRecordSz + 16));
+                    _pulses.forEach([&writer](PulseEntry const &pulseEntry) {
+                        writer.write(pulseEntry.entity.toRecord(
+                            pulseEntry.token.has_value()));
+                    });
+                }
+
+                if (alarms)
+                {
+                    writer.reserve(
+                        _alarms->size() *
+                        (ttt::detail::ImageWriter::kAlarmRecordSz + 16));
+                    _alarms->forEach([&writer](AlarmEntry const &alarmEntry) {
+                        writer.write(alarmEntry.entity.toRecord());
+                    });
+                }
+            }
+        }
+
+        return buffer.size() - start;
+    }
+
+    bool addTimer(std::string const &name, std::chrono::milliseconds resolution,
+                  std::chrono::milliseconds duration, bool repeating,
+                  std::function<void(TimerState const &)> onTick, bool tickNow,
+                  std::string const &group, ttt::LaneId lane)
+    {
+        if (!_schedule->hasLane(lane))
+        {
+            throw std::runtime_error(ttt::detail::kErrorUnknownLane);
+        }
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto entry = emplaceTimer(name, name, resolution, duration,
+                                  tickNow ? duration + resolution : duration,
+                                  repeating, group,
+                                  ttt::kLazyResolution == resolution);
+
+        if (entry)
+        {
+            entry->lane = lane;
+            entry->entity.setAction(std::move(onTick));
+            arm(*entry, tickNow);
+            notify(TimerChange::Added, entry->entity);
+        }
+
+        return nullptr != entry;
+    }
+
+    bool removeTimer(std::string const &name)
+    {
+        bool ret = false;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _timers.find(name))
+        {
+            notify(TimerChange::Removed, entry->entity);
+            eraseTimer(*entry);
+
+            ret = true;
+        }
+
+        return ret;
+    }
+
+    bool resetTimer(std::string const &name)
+    {
+        bool ret = false;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _timers.find(name))
+        {
+            disarm(*entry);            // Cancel timer ticking.
+            entry->entity.reset(true); // Reset timer state.
+
+            // Reschedule the timer entity.
+            arm(*entry, true);
+            notify(TimerChange::Reset, entry->entity);
+
+            ret = true;
+        }
+
+        return ret;
+    }
+
+    bool stopTimer(std::string const &name, bool resetState)
+    {
+        bool ret = false;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _timers.find(name))
+        {
+            disarm(*entry); // Cancel timer ticking.
+            if (resetState)
+            {
+                entry->entity.reset(false);
+            }
+            publish(*entry, false);
+            notify(TimerChange::Stopped, entry->entity);
+
+            ret = true;
+        }
+
+        return ret;
+    }
+
+    bool resumeTimer(std::string const &name)
+    {
+        bool ret = false;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _timers.find(name);
+            entry and entry->token.has_value() == false)
+        {
+            // Reschedule the timer entity.
+            arm(*entry, false);
+            notify(TimerChange::Resumed, entry->entity);
+
+            ret = true;
+        }
+
+        return ret;
+    }
+
+    std::size_t pauseTimers(TimerSelection const &selection, bool resetState)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto targets = select(selection);
+
+        for (auto *entry : targets)
+        {
+            disarm(*entry); // Cancel timer ticking.
+            if (resetState)
+            {
+                entry->entity.reset(false);
+            }
+            publish(*entry, false);
+            notify(TimerChange::Stopped, entry->entity);
+        }
+
+        return targets.size();
+    }
+
+    std::size_t resumeTimers(TimerSelection const &selection)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto targets = select(selection);
+        std::erase_if(targets, [](TimerEntry *entry) {
+            return entry->token.has_value(); // Already running.
+        });
+
+        rearm(targets, false, TimerChange::Resumed);
+        return targets.size();
+    }
+
+    std::size_t resetTimers(TimerSelection const &selection)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto targets = select(selection);
+
+        for (auto *entry : targets)
+        {
+            disarm(*entry);            // Cancel timer ticking.
+            entry->entity.reset(true); // Reset timer state.
+        }
+
+        rearm(targets, true, TimerChange::Reset);
+        return targets.size();
+    }
+
+    std::size_t removeTimers(TimerSelection const &selection)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto targets = select(selection);
+
+        for (auto *entry : targets)
+        {
+            notify(TimerChange::Removed, entry->entity);
+            eraseTimer(*entry);
+        }
+
+        return targets.size();
+    }
+
+    bool addPulse(std::string const &name, std::chrono::milliseconds period,
+                  std::function<void(PulseState const &)> onBeat, bool beatNow)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto entry = _pulses.emplace(name, name, period,
+                                     std::chrono::system_clock::time_point{},
+                                     0u, 0u);
+
+        if (entry)
+        {
+            entry->entity.setAction(std::move(onBeat));
+            entry->token.emplace(schedulePulse(entry->entity, beatNow));
+        }
+
+        return nullptr != entry;
+    }
+
+    bool removePulse(std::string const &name)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _pulses.erase(name);
+    }
+
+    bool pausePulse(std::string const &name)
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto entry = _pulses.find(name);
+
+        if (entry)
+        {
+            entry->token.reset(); // Cancel beating.
+        }
 
-class TimerEntity
-{
-    ttt::TimerState _state;
-    std::function<void(ttt::TimerState const &)> _onTick;
+        return nullptr != entry;
+    }
 
-  public:
-    TimerEntity(std::string const &state)
-        : TimerEntity(split(state, kElementFieldsDelimiter))
+    bool resumePulse(std::string const &name)
     {
+        bool ret = false;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _pulses.find(name);
+            entry and entry->token.has_value() == false)
+        {
+            entry->entity.skipMisses();
+            entry->token.emplace(schedulePulse(entry->entity, false));
+
+            ret = true;
+        }
+
+        return ret;
     }
-    TimerEntity(std::vector<std::string> const &args)
-        : TimerEntity(args.at(1), millis_from(args.at(2)),
-                      millis_from(args.at(3)), millis_from(args.at(4)),
-                      args.at(5) == "1" ? true : false)
+
+    std::optional<PulseStatus> pulseStatus(std::string const &name) const
     {
+        std::optional<PulseStatus> ret;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _pulses.find(name))
+        {
+            ret = entry->entity.status(entry->token.has_value());
+        }
+
+        return ret;
     }
-    TimerEntity(std::string const &name, std::chrono::milliseconds resolution,
-                std::chrono::milliseconds duration,
-                std::chrono::milliseconds remaining, bool repeating)
-        : _state{name, resolution, duration, remaining, repeating}
+
+    bool addAlarm(std::string const &name,
+                  std::chrono::system_clock::time_point deadline,
+                  std::function<void(AlarmState const &)> onFire)
     {
+        return _alarms->add(name, std::move(onFire), name, deadline);
     }
 
-    void setAction(std::function<void(ttt::TimerState const &)> action)
+    bool removeAlarm(std::string const &name)
     {
-        _onTick = std::move(action);
+        return _alarms->remove(name);
     }
 
-    void operator()()
+    void setObserver(
+        std::function<void(TimerChange, TimerState const &)> observer)
     {
-        if (_onTick)
-        {
-            _onTick(_state);
-        }
-        else
-        {
-            throw std::runtime_error(kNonCallableEntity);
-        }
+        std::lock_guard<std::mutex> lock(_mtx);
+        _observer = std::move(observer);
     }
 
-    std::string toString() const
+    void setJournal(
+        std::function<void(TimerChange, TimerState const &)> journal)
     {
-        return stich(kElementFieldsDelimiter, kTimerElement, _state.name,
-                     to_string(_state.resolution), to_string(_state.duration),
-                     to_string(_state.remaining.load()),
-                     (_state.repeating ? "1" : "0"));
+        std::lock_guard<std::mutex> lock(_mtx);
+        _journal = std::move(journal);
     }
 
-    // Remove a "resolution" from remaining. Returns whether it can tick again.
-    bool tick()
+    void setBatchDelivery(
+        std::chrono::milliseconds window,
+        std::function<void(std::span<const TimerTick>)> onBatch,
+        std::size_t maxQueued)
     {
-        bool ret = true;
+        std::lock_guard<std::mutex> lock(_batchMtx);
+        _batcher.configure(*_schedule, window, std::move(onBatch), maxQueued);
+    }
 
-        if (0 == _state.remaining.load().count())
-        {
-            throw std::runtime_error(kInvalidTimerCountdown);
-        }
-        else
+    std::optional<TimerHandle> timerHandle(std::string const &name) const
+    {
+        std::optional<TimerHandle> ret;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto h = _timers.handle(name))
         {
-            _state.remaining.store(_state.remaining.load() - _state.resolution);
+            ret = TimerHandle{h->index, h->generation};
         }
 
-        if (0 == _state.remaining.load().count())
+        return ret;
+    }
+
+    std::optional<std::string> timerName(TimerHandle handle) const
+    {
+        std::optional<std::string> ret;
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        if (auto entry = _timers.get({handle.index, handle.generation}))
         {
-            if (_state.repeating)
-            {
-                reset(false); // Repeating clocks re-start from "duration".
-            }
-            ret = _state.repeating;
+            ret = entry->entity.state().name;
         }
 
         return ret;
     }
 
-    void reset(bool addStep)
+    std::optional<TimerSnapshot> timerSnapshot(TimerHandle handle) const
     {
-        _state.remaining =
-            _state.duration + (addStep ? _state.resolution : 0ms);
+        return _board.get({handle.index, handle.generation});
     }
 
-    ttt::TimerState const &state() const
+    void timersSnapshot(
+        std::function<void(TimerHandle, TimerSnapshot const &)> const &visit)
+        const
     {
-        return _state;
+        _board.forEach(visit);
     }
-};
-
-struct TimerEntry
-{
-    std::shared_ptr<TimerEntity> entity;
-    std::optional<ttt::CallToken> token;
 
-    template <class... Args>
-    explicit TimerEntry(Args &&...args)
-        : entity(std::make_shared<TimerEntity>(std::forward<Args>(args)...))
+  private:
+    /**
+     * @brief Marks an export that reads timers from the snapshot board
+     * without the lock.
+     *
+     * @details Exports refer to the entities for their immutable members.
+     * While one is running, removed timers are retired instead of destroyed;
+     * the last export to finish destroys them.
+     */
+    class ExportPin
     {
-    }
-};
+        TimelineImpl const &_owner;
 
-} // namespace
+      public:
+        std::uint64_t epoch;
 
-namespace ttt
-{
+        explicit ExportPin(TimelineImpl const &owner) : _owner(owner)
+        {
+            std::lock_guard<std::mutex> lock(_owner._mtx);
+            ++_owner._exporters;
+            epoch = _owner._board.pin();
+        }
 
-class TimelineImpl
-{
-    mutable std::mutex _mtx;
-    std::map<std::string, TimerEntry> _timers;
-    ttt::CallScheduler _schedule;
+        ExportPin(ExportPin const &) = delete;
+        ExportPin &operator=(ExportPin const &) = delete;
 
-  public:
-    TimelineImpl() = default;
+        // Retired timers are no longer part of the timeline, so destroying
+        // them does not change it. Timelines are never created const.
+        ~ExportPin()
+        {
+            std::lock_guard<std::mutex> lock(_owner._mtx);
+            --_owner._exporters;
+            const_cast<TimelineImpl &>(_owner).reclaim();
+        }
+    };
 
-    TimelineImpl(std::vector<std::string> const &elements,
-                 std::function<void(ttt::TimerState const &)> timersEvent)
+    // Entries matching the selection, each listed once. Expects a held lock.
+    std::vector<TimerEntry *> select(TimerSelection const &selection) const
     {
-        for (auto const &el : elements)
-        {
-            auto fields = split(el, kElementFieldsDelimiter);
-            auto const &entityType = fields.at(0);
+        std::vector<TimerEntry *> ret;
 
-            if (entityType == kTimerElement)
+        switch (selection.kind)
+        {
+        case TimerSelection::Kind::Group:
+            for (auto const &group : selection.values)
             {
-                if (auto [it, ok] = _timers.try_emplace(fields.at(1), fields);
-                    true == ok)
+                _timers.forEachIn(group, [&ret](TimerEntry &entry) {
+                    ret.push_back(&entry);
+                });
+            }
+            break;
+
+        case TimerSelection::Kind::Prefix:
+            _timers.forEach([&ret, &selection](TimerEntry &entry) {
+                auto const &name = entry.entity.state().name;
+                if (std::any_of(selection.values.begin(),
+                                selection.values.end(),
+                                [&name](std::string const &prefix) {
+                                    return name.starts_with(prefix);
+                                }))
                 {
-                    it->second.entity->setAction(timersEvent);
-                    if ("1" == fields.at(6))
-                    {
-                        it->second.token.emplace(
-                            scheduleTimer(it->second.entity, false));
-                    }
+                    ret.push_back(&entry);
                 }
-            }
-            else if (entityType == kPulseElement)
-            {
-                throw std::runtime_error(kNotIMplemented);
-            }
-            else if (entityType == kAlarmElement)
-            {
-                throw std::runtime_error(kNotIMplemented);
-            }
-            else
+            });
+            break;
+
+        case TimerSelection::Kind::Names:
+            for (auto const &name : selection.values)
             {
-                throw std::runtime_error(kInvalidElementType);
+                if (auto entry = _timers.find(name))
+                {
+                    ret.push_back(entry);
+                }
             }
+            std::sort(ret.begin(), ret.end());
+            ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+            break;
         }
+
+        return ret;
     }
 
-    std::vector<std::string> serialize(bool timers, bool pulses,
-                                       bool alarms) const
+    // Schedules the given entries with a single scheduler call per lane.
+    // Lazy timers are scheduled one by one, since their first delays differ.
+    void rearm(std::vector<TimerEntry *> const &entries, bool tickNow,
+               TimerChange change)
     {
-        std::lock_guard<std::mutex> lock(_mtx);
-
-        std::vector<std::string> ret;
-        ret.reserve((timers ? _timers.size() : 0) + (pulses ? 0 : 0) +
-                    (alarms ? 0 : 0));
-
-        if (timers)
+        std::vector<TimerEntry *> batched;
+        batched.reserve(entries.size());
+        for (auto *entry : entries)
         {
-            for (auto const &[name, timerEntry] : _timers)
+            if (entry->entity.lazy())
             {
-                ret.emplace_back(timerEntry.entity->toString() +
-                                 kElementFieldsDelimiter +
-                                 (timerEntry.token.has_value() ? "1" : "0"));
+                arm(*entry, tickNow);
+                continue;
             }
+
+            publish(*entry, true);
+            batched.push_back(entry);
         }
 
-        if (pulses)
+        std::stable_sort(batched.begin(), batched.end(),
+                         [](TimerEntry const *a, TimerEntry const *b) {
+                             return a->lane < b->lane;
+                         });
+
+        for (auto first = batched.begin(); first != batched.end();)
         {
-            // TODO: Implementation.
+            auto const lane = (*first)->lane;
+            auto last = std::find_if(first, batched.end(),
+                                     [lane](TimerEntry const *entry) {
+                                         return entry->lane != lane;
+                                     });
+
+            std::vector<std::pair<std::function<ttt::Result()>,
+                                  std::chrono::microseconds>>
+                calls;
+            calls.reserve(last - first);
+            for (auto it = first; it != last; ++it)
+            {
+                calls.emplace_back(timerTask(**it),
+                                   (*it)->entity.state().resolution);
+            }
+
+            auto tokens = _schedule->add(
+                std::move(calls),
+                ttt::TaskOptions{.immediate = tickNow, .lane = lane});
+            for (std::size_t i = 0; first != last; ++first, ++i)
+            {
+                (*first)->token.emplace(std::move(tokens[i]));
+            }
         }
 
-        if (alarms)
+        for (auto *entry : entries)
         {
-            // TODO: Implementation.
+            notify(change, entry->entity);
         }
-
-        return ret;
     }
 
-    bool addTimer(std::string const &name, std::chrono::milliseconds resolution,
-                  std::chrono::milliseconds duration, bool repeating,
-                  std::function<void(TimerState const &)> onTick, bool tickNow)
+    // Adds a timer and publishes its state, as inactive. Expects a held lock.
+    template <class... Args>
+    TimerEntry *emplaceTimer(std::string_view name, Args &&...args)
     {
-        std::lock_guard<std::mutex> lock(_mtx);
-        auto [it, ok] = _timers.try_emplace(
-            name, name, resolution, duration,
-            tickNow ? duration + resolution : duration, repeating);
+        TimerEntry *ret = nullptr;
+        reclaim();
 
-        if (ok)
+        if (auto h = _timers.add(name, std::forward<Args>(args)...))
         {
-            it->second.entity->setAction(std::move(onTick));
-            it->second.token.emplace(scheduleTimer(it->second.entity, tickNow));
+            ret = _timers.get(*h);
+            ret->handle = *h;
+            _board.publish(*h, ret->entity, false);
         }
 
-        return ok;
+        return ret;
     }
 
-    bool removeTimer(std::string const &name)
+    // Expects a held lock and no pending tick of the timer.
+    void publish(TimerEntry const &entry, bool active)
     {
-        std::lock_guard<std::mutex> lock(_mtx);
-        return _timers.erase(name);
+        _board.update(entry.handle.index, entry.entity, active);
     }
 
-    bool resetTimer(std::string const &name)
+    // Starts the countdown and schedules the timer. Expects a held lock and
+    // no pending tick of the timer.
+    void arm(TimerEntry &entry, bool tickNow)
     {
-        bool ret = false;
-        std::lock_guard<std::mutex> lock(_mtx);
+        entry.entity.start();
+        publish(entry, true);
+        entry.token.emplace(scheduleTimer(entry, tickNow));
+    }
 
-        if (auto it = _timers.find(name); _timers.end() != it)
-        {
-            it->second.token.reset();       // Cancel timer ticking.
-            it->second.entity->reset(true); // Reset timer state.
+    // Cancels timer ticking, freezing the countdown. Expects a held lock.
+    static void disarm(TimerEntry &entry)
+    {
+        entry.token.reset();
+        entry.entity.halt();
+    }
 
-            // Reschedule the timer entity.
-            it->second.token.emplace(scheduleTimer(it->second.entity, true));
+    void eraseTimer(TimerEntry &entry)
+    {
+        _board.retire(entry.handle.index);
+        reclaim();
 
-            ret = true;
+        if (_exporters)
+        {
+            // An export may still read the entry: stop it, destroy it later.
+            entry.token.reset();
+            _graveyard.push_back(entry.handle.index);
+            _timers.retire(entry.handle);
+        }
+        else
+        {
+            _timers.erase(entry.entity.state().name);
         }
+    }
 
-        return ret;
+    // Destroys the timers retired during exports, once none is running.
+    void reclaim()
+    {
+        if (!_exporters && !_graveyard.empty())
+        {
+            for (auto index : _graveyard)
+            {
+                _timers.release(index);
+            }
+            _graveyard.clear();
+        }
     }
 
-    bool stopTimer(std::string const &name, bool resetState)
+    void notify(TimerChange change, TimerEntity const &ent) const
     {
-        bool ret = false;
-        std::lock_guard<std::mutex> lock(_mtx);
+        if (_journal)
+        {
+            _journal(change, ent.state());
+        }
+        if (_observer)
+        {
+            _observer(change, ent.state());
+        }
+    }
 
-        if (auto it = _timers.find(name); _timers.end() != it)
+    // Adds a timer from its serialized form, scheduling it if it was active.
+    template <class Source>
+    void loadTimer(std::string_view name, bool active,
+                   std::function<void(ttt::TimerState const &)> const &onTick,
+                   Source const &src)
+    {
+        if (auto entry = emplaceTimer(name, src))
         {
-            it->second.token.reset(); // Cancel timer ticking.
-            if (resetState)
+            entry->entity.setAction(onTick);
+            if (active)
             {
-                it->second.entity->reset(false);
+                arm(*entry, false);
             }
-
-            ret = true;
         }
+    }
 
-        return ret;
+    template <class Source>
+    void loadPulse(std::string_view name, bool active,
+                   std::function<void(ttt::PulseState const &)> const &onBeat,
+                   Source const &src)
+    {
+        if (auto entry = _pulses.emplace(name, src))
+        {
+            entry->entity.setAction(onBeat);
+            if (active)
+            {
+                entry->token.emplace(schedulePulse(entry->entity, false));
+            }
+        }
     }
 
-    bool resumeTimer(std::string const &name)
+    // As with timers, the callback refers to the entity directly.
+    [[nodiscard]] ttt::CallToken schedulePulse(PulseEntity &ent, bool beatNow)
     {
-        bool ret = false;
-        std::lock_guard<std::mutex> lock(_mtx);
+        auto callback = [ptr = &ent] {
+            ptr->beat();
+            return ttt::Result::Repeat;
+        };
 
-        if (auto it = _timers.find(name);
-            _timers.end() != it and it->second.token.has_value() == false)
-        {
-            // Reschedule the timer entity.
-            it->second.token.emplace(scheduleTimer(it->second.entity, false));
+        return _schedule->add(std::move(callback), ent.state().period,
+                              beatNow);
+    }
 
-            ret = true;
+    // The callback refers to the entity directly: destroying the returned
+    // token waits for running callbacks and prevents further invocations,
+    // hence it has to be destroyed before the entity. Lazy timers run on
+    // expiry, i.e. every duration once the remaining time elapses.
+    [[nodiscard]] ttt::CallToken scheduleTimer(TimerEntry &entry,
+                                               bool tickNow)
+    {
+        auto const &state = entry.entity.state();
+        if (entry.entity.lazy())
+        {
+            return _schedule->addAfter(
+                timerTask(entry), tickNow ? 0ms : state.remaining.load(),
+                state.duration, entry.lane);
         }
-
-        return ret;
+        return _schedule->add(
+            timerTask(entry), state.resolution,
+            ttt::TaskOptions{.immediate = tickNow, .lane = entry.lane});
     }
 
-  private:
-    [[nodiscard]] ttt::CallToken scheduleTimer(
-        std::shared_ptr<TimerEntity> &ent, bool tickNow)
+    std::function<ttt::Result()> timerTask(TimerEntry &entry)
     {
-        auto callback = [observer = std::weak_ptr(ent)] {
+        return [ptr = &entry.entity, board = &_board, batcher = &_batcher,
+                index = entry.handle.index] {
             auto ret = ttt::Result::Finished;
-            if (auto ptr = observer.lock())
+            if (ptr->tick()) // Update timer state.
+            {
+                ret = ttt::Result::Repeat;
+            }
+            board->update(index, *ptr);
+            batcher->push(*ptr);
+            if (ptr->hasAction())
             {
-                if (ptr->tick()) // Update timer state.
-                {
-                    ret = ttt::Result::Repeat;
-                }
                 (*ptr)(); // Call associated action.
             }
             return ret;
         };
-
-        return _schedule.add(std::move(callback), ent->state().resolution,
-                             tickNow);
     }
 };
 
@@ -389,13 +2291,34 @@ std::string StateStringFrom(std::string const &key, std::string const &value)
     return stich(kElementFieldsDelimiter, key, value);
 }
 
-Timeline::Timeline() : _impl(std::make_unique<TimelineImpl>())
+Timeline::Timeline() : _impl(std::make_unique<TimelineImpl>(nullptr))
+{
+}
+
+Timeline::Timeline(std::shared_ptr<CallScheduler> scheduler)
+    : _impl(std::make_unique<TimelineImpl>(std::move(scheduler)))
 {
 }
 
 Timeline::Timeline(std::vector<std::string> const &elements,
-                   std::function<void(TimerState const &)> timersEvent)
-    : _impl(std::make_unique<TimelineImpl>(elements, std::move(timersEvent)))
+                   std::function<void(TimerState const &)> timersEvent,
+                   std::shared_ptr<CallScheduler> scheduler,
+                   std::function<void(PulseState const &)> pulsesEvent,
+                   std::function<void(AlarmState const &)> alarmsEvent)
+    : _impl(std::make_unique<TimelineImpl>(
+          elements, std::move(timersEvent), std::move(scheduler),
+          std::move(pulsesEvent), std::move(alarmsEvent)))
+{
+}
+
+Timeline::Timeline(std::span<const std::byte> image,
+                   std::function<void(TimerState const &)> timersEvent,
+                   std::shared_ptr<CallScheduler> scheduler,
+                   std::function<void(PulseState const &)> pulsesEvent,
+                   std::function<void(AlarmState const &)> alarmsEvent)
+    : _impl(std::make_unique<TimelineImpl>(
+          image, std::move(timersEvent), std::move(scheduler),
+          std::move(pulsesEvent), std::move(alarmsEvent)))
 {
 }
 
@@ -407,14 +2330,20 @@ std::vector<std::string> Timeline::serialize(bool timers, bool pulses,
     return _impl->serialize(timers, pulses, alarms);
 }
 
+std::size_t Timeline::serialize(std::vector<std::byte> &buffer, bool timers,
+                                bool pulses, bool alarms) const
+{
+    return _impl->serialize(buffer, timers, pulses, alarms);
+}
+
 bool Timeline::timerAdd(std::string const &name,
                         std::chrono::milliseconds resolution,
                         std::chrono::milliseconds duration, bool repeating,
                         std::function<void(TimerState const &)> onTick,
-                        bool tickNow)
+                        bool tickNow, std::string const &group, LaneId lane)
 {
     return _impl->addTimer(name, resolution, duration, repeating,
-                           std::move(onTick), tickNow);
+                           std::move(onTick), tickNow, group, lane);
 }
 
 bool Timeline::timerRemove(std::string const &name)
@@ -442,4 +2371,110 @@ bool Timeline::timerResume(std::string const &name)
     return _impl->resumeTimer(name);
 }
 
+std::size_t Timeline::timersPause(TimerSelection const &selection)
+{
+    return _impl->pauseTimers(selection, false);
+}
+
+std::size_t Timeline::timersResume(TimerSelection const &selection)
+{
+    return _impl->resumeTimers(selection);
+}
+
+std::size_t Timeline::timersReset(TimerSelection const &selection)
+{
+    return _impl->resetTimers(selection);
+}
+
+std::size_t Timeline::timersStop(TimerSelection const &selection)
+{
+    return _impl->pauseTimers(selection, true);
+}
+
+std::size_t Timeline::timersRemove(TimerSelection const &selection)
+{
+    return _impl->removeTimers(selection);
+}
+
+bool Timeline::pulseAdd(std::string const &name,
+                        std::chrono::milliseconds period,
+                        std::function<void(PulseState const &)> onBeat,
+                        bool beatNow)
+{
+    return _impl->addPulse(name, period, std::move(onBeat), beatNow);
+}
+
+bool Timeline::pulseRemove(std::string const &name)
+{
+    return _impl->removePulse(name);
+}
+
+bool Timeline::pulsePause(std::string const &name)
+{
+    return _impl->pausePulse(name);
+}
+
+bool Timeline::pulseResume(std::string const &name)
+{
+    return _impl->resumePulse(name);
+}
+
+std::optional<PulseStatus> Timeline::pulseStatus(std::string const &name) const
+{
+    return _impl->pulseStatus(name);
+}
+
+bool Timeline::alarmAdd(std::string const &name,
+                        std::chrono::system_clock::time_point deadline,
+                        std::function<void(AlarmState const &)> onFire)
+{
+    return _impl->addAlarm(name, deadline, std::move(onFire));
+}
+
+bool Timeline::alarmRemove(std::string const &name)
+{
+    return _impl->removeAlarm(name);
+}
+
+void Timeline::setTimersObserver(
+    std::function<void(TimerChange, TimerState const &)> observer)
+{
+    _impl->setObserver(std::move(observer));
+}
+
+void Timeline::setTimersJournal(
+    std::function<void(TimerChange, TimerState const &)> journal)
+{
+    _impl->setJournal(std::move(journal));
+}
+
+void Timeline::setTimersBatchDelivery(
+    std::chrono::milliseconds window,
+    std::function<void(std::span<const TimerTick>)> onBatch,
+    std::size_t maxQueued)
+{
+    _impl->setBatchDelivery(window, std::move(onBatch), maxQueued);
+}
+
+std::optional<TimerHandle> Timeline::timerHandle(std::string const &name) const
+{
+    return _impl->timerHandle(name);
+}
+
+std::optional<std::string> Timeline::timerName(TimerHandle handle) const
+{
+    return _impl->timerName(handle);
+}
+
+std::optional<TimerSnapshot> Timeline::timerSnapshot(TimerHandle handle) const
+{
+    return _impl->timerSnapshot(handle);
+}
+
+void Timeline::timersSnapshot(
+    std::function<void(TimerHandle, TimerSnapshot const &)> const &visit) const
+{
+    _impl->timersSnapshot(visit);
+}
+
 } // namespace ttt
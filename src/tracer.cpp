@@ -0,0 +1,183 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "task_timetable/tracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+struct TraceEvent
+{
+    std::int64_t ts; // Steady clock nanoseconds.
+    char const *name;
+    std::uint64_t id;
+    std::int64_t value;
+    char phase;
+};
+
+// Events of a single thread. The lock is only contended while writing a
+// trace, since each thread records in its own ring.
+struct TraceRing
+{
+    std::mutex mtx;
+    std::vector<TraceEvent> events;
+    std::uint64_t head = 0; // Number of events ever recorded.
+    char const *label;
+
+    TraceRing(std::size_t capacity, char const *threadLabel)
+        : events(capacity), label(threadLabel)
+    {
+    }
+};
+
+struct TracerState
+{
+    std::mutex mtx;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    std::size_t capacity = 0;
+    // Incremented on start, so that threads drop rings of older traces.
+    std::atomic<std::uint64_t> session{0};
+};
+
+TracerState &state()
+{
+    static TracerState s;
+    return s;
+}
+
+std::shared_ptr<TraceRing> attach(std::uint64_t &session)
+{
+    auto &s = state();
+    std::lock_guard<std::mutex> lock(s.mtx);
+
+    session = s.session.load(std::memory_order_acquire);
+    auto ret = std::make_shared<TraceRing>(std::max<std::size_t>(1, s.capacity),
+                                           ttt::detail::traceLabel());
+    s.rings.push_back(ret);
+
+    return ret;
+}
+
+// Chrome traces expect microseconds, fractions keep nanosecond precision.
+void writeEvent(std::ostream &out, TraceEvent const &ev, std::size_t tid)
+{
+    char ts[32];
+    std::snprintf(ts, sizeof(ts), "%lld.%03lld",
+                  static_cast<long long>(ev.ts / 1000),
+                  static_cast<long long>(ev.ts % 1000));
+
+    out << ",\n" << R"({"name":")" << ev.name
+        << R"(","ph":")" << ev.phase << R"(","ts":)" << ts
+        << R"(,"pid":1,"tid":)" << tid;
+    if ('i' == ev.phase)
+    {
+        out << R"(,"s":"t")";
+    }
+    out << R"(,"args":{"task":)" << ev.id << R"(,"value":)" << ev.value
+        << "}}";
+}
+
+} // namespace
+
+namespace ttt
+{
+
+namespace detail
+{
+
+void traceRecord(char phase, char const *name, std::uint64_t id,
+                 std::int64_t value)
+{
+    thread_local std::shared_ptr<TraceRing> ring;
+    thread_local std::uint64_t session = 0;
+
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+    if (!ring || session != state().session.load(std::memory_order_acquire))
+    {
+        ring = attach(session);
+    }
+
+    std::lock_guard<std::mutex> lock(ring->mtx);
+    ring->events[ring->head++ % ring->events.size()] = {
+        .ts = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(),
+        .name = name,
+        .id = id,
+        .value = value,
+        .phase = phase};
+}
+
+} // namespace detail
+
+void Tracer::start(std::size_t eventsPerThread)
+{
+    auto &s = state();
+    {
+        std::lock_guard<std::mutex> lock(s.mtx);
+        s.rings.clear();
+        s.capacity = eventsPerThread;
+        s.session.fetch_add(1, std::memory_order_release);
+    }
+    detail::tracing.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::stop()
+{
+    detail::tracing.store(false, std::memory_order_relaxed);
+}
+
+std::size_t Tracer::write(std::ostream &out)
+{
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    {
+        auto &s = state();
+        std::lock_guard<std::mutex> lock(s.mtx);
+        rings = s.rings;
+    }
+
+    std::size_t ret = 0;
+    out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    for (std::size_t i = 0; i < rings.size(); ++i)
+    {
+        auto &ring = *rings[i];
+        auto const tid = i + 1;
+
+        std::lock_guard<std::mutex> lock(ring.mtx);
+        out << (0 == i ? "\n" : ",\n")
+            << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << tid
+            << R"(,"args":{"name":")" << ring.label << R"("}})";
+
+        auto const capacity = ring.events.size();
+        auto const first = ring.head > capacity ? ring.head - capacity : 0;
+        for (auto pos = first; pos < ring.head; ++pos)
+        {
+            writeEvent(out, ring.events[pos % capacity], tid);
+            ++ret;
+        }
+    }
+    out << "\n]}\n";
+
+    return ret;
+}
+
+std::size_t Tracer::write(std::filesystem::path const &file)
+{
+    std::ofstream out(file, std::ios::trunc);
+    auto const ret = write(out);
+
+    out.flush();
+    if (!out)
+    {
+        throw std::runtime_error(detail::kErrorTraceFile);
+    }
+
+    return ret;
+}
+
+} // namespace ttt
@@ -3,3 +3,79 @@
 
 // This is all that is needed to compile a test-runner executable.
 // More tests can be added here, or in a new tests/*.cpp file.
+
+#include "test_utils.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+thread_local std::size_t allocationCount = 0;
+
+} // namespace
+
+// Counts allocations, for tests asserting that hot paths do not allocate.
+// Defined apart from the tests, so that the compiler does not pair inlined
+// deallocations with the allocation function.
+void *operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (auto ret = std::malloc(size ? size : 1))
+    {
+        return ret;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, std::nothrow_t const &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::nothrow_t const &) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept
+{
+    std::free(ptr);
+}
+
+std::size_t test::allocations()
+{
+    return allocationCount;
+}
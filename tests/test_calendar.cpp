@@ -0,0 +1,133 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/calendar.h"
+#include "task_timetable/clock.h"
+#include "task_timetable/scheduler.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+using ttt::CalendarSchedule;
+
+// Time point of the given day and time of day, in UTC.
+static CalendarSchedule::time_point at(std::chrono::year_month_day date,
+                                       std::chrono::minutes timeOfDay)
+{
+    return std::chrono::sys_days(date) + timeOfDay;
+}
+
+// Wait (in real time) until the counter reaches the expected value.
+static bool Reaches(std::atomic_size_t const &counter, std::size_t expected)
+{
+    auto start = test::now();
+    while (counter.load() < expected)
+    {
+        if (test::delta(start) > 5s)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return counter.load() == expected;
+}
+
+TEST_CASE("Calendar expressions")
+{
+    for (auto bad : {"", "* * * *", "* * * * * *", "60 * * * *", "a * * * *",
+                     "5-1 * * * *", "*/0 * * * *", "* * 0 * *", "* * * * 8",
+                     "1,,2 * * * *", "* * * 13 *"})
+    {
+        CHECK_THROWS_WITH_AS(CalendarSchedule schedule(bad);
+                             , ttt::detail::kErrorCalendarExpression,
+                             std::runtime_error);
+    }
+    CHECK_NOTHROW(CalendarSchedule schedule(" 0  2 * * * "));
+}
+
+TEST_CASE("Calendar next occurrences")
+{
+    using namespace std::chrono;
+    auto const monday = 2024y / March / 4;
+
+    CalendarSchedule daily("0 2 * * *");
+    CHECK(daily.next(at(monday, 1h)) == at(monday, 2h));
+    CHECK(daily.next(at(monday, 2h)) == at(2024y / March / 5, 2h));
+    CHECK(daily.next(at(monday, 2h) - 1s) == at(monday, 2h));
+
+    CalendarSchedule quarters("15,45 * * * *");
+    CHECK(quarters.next(at(monday, 10h + 15min)) == at(monday, 10h + 45min));
+    CHECK(quarters.next(at(monday, 10h + 50min)) == at(monday, 11h + 15min));
+    CHECK(quarters.next(at(monday, 23h + 50min)) ==
+          at(2024y / March / 5, 15min));
+
+    CalendarSchedule mondays("0 9 * * 1");
+    CHECK(mondays.next(at(monday, 10h)) == at(2024y / March / 11, 9h));
+
+    CalendarSchedule sundays("0 0 * * 7");
+    CHECK(sundays.next(at(monday, 0h)) == at(2024y / March / 10, 0h));
+
+    // Either day field matches, when both are restricted.
+    CalendarSchedule fridayOr13th("0 0 13 * 5");
+    CHECK(fridayOr13th.next(at(monday, 0h)) == at(2024y / March / 8, 0h));
+    CHECK(fridayOr13th.next(at(2024y / March / 12, 0h)) ==
+          at(2024y / March / 13, 0h));
+
+    CalendarSchedule steps("*/20 8-10/2 * * *");
+    CHECK(steps.next(at(monday, 8h + 40min)) == at(monday, 10h));
+    CHECK(steps.next(at(monday, 10h + 40min)) == at(2024y / March / 5, 8h));
+
+    CalendarSchedule newYear("0 0 1 1 *");
+    CHECK(newYear.next(at(monday, 0h)) == at(2025y / January / 1, 0h));
+
+    CalendarSchedule leapDay("0 0 29 2 *");
+    CHECK(leapDay.next(at(monday, 0h)) == at(2028y / February / 29, 0h));
+
+    CalendarSchedule never("0 0 30 2 *");
+    CHECK_FALSE(never.next(at(monday, 0h)));
+
+    // 02:00 in UTC+2 is midnight UTC.
+    CalendarSchedule shifted("0 2 * * *", 120min);
+    CHECK(shifted.next(at(monday, 1h)) == at(2024y / March / 5, 0h));
+}
+
+TEST_CASE("Calendar tasks run on their occurrences")
+{
+    using namespace std::chrono;
+
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    // Virtual time counts from the Unix epoch.
+    auto const wallNow = [] {
+        auto const now = ttt::VirtualClock::now().time_since_epoch();
+        return sys_seconds(duration_cast<seconds>(now));
+    };
+
+    CalendarSchedule const quarters("15,45 * * * *");
+    auto const first = *quarters.next(wallNow());
+
+    ttt::BasicCallScheduler<ttt::VirtualClock> plan;
+    auto token = plan.add(quarters, fun);
+
+    ttt::VirtualClock::advance(first - wallNow() - 1s);
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_MESSAGE(0 == callCount.load(), "Task ran before its occurrence");
+
+    ttt::VirtualClock::advance(1s);
+    REQUIRE_MESSAGE(Reaches(callCount, 1), "Task did not run on occurrence");
+
+    ttt::VirtualClock::advance(29min);
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_MESSAGE(1 == callCount.load(), "Task ran between occurrences");
+
+    ttt::VirtualClock::advance(1min);
+    REQUIRE_MESSAGE(Reaches(callCount, 2), "Task was not re-armed");
+}
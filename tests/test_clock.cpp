@@ -0,0 +1,265 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/clock.h"
+#include "task_timetable/scheduler.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+using VirtualScheduler = ttt::BasicCallScheduler<ttt::VirtualClock>;
+
+// Wait (in real time) until the counter reaches the expected value.
+static bool Reaches(std::atomic_size_t const &counter, std::size_t expected)
+{
+    auto start = test::now();
+    while (counter.load() < expected)
+    {
+        if (test::delta(start) > 5s)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return counter.load() == expected;
+}
+
+TEST_CASE("Virtual clock only moves when advanced")
+{
+    auto const t0 = ttt::VirtualClock::now();
+    std::this_thread::sleep_for(1ms);
+    REQUIRE_MESSAGE(t0 == ttt::VirtualClock::now(), "Time moved on its own");
+
+    ttt::VirtualClock::advance(1h);
+    REQUIRE_MESSAGE(t0 + 1h == ttt::VirtualClock::now(), "Advance failed");
+
+    ttt::VirtualClock::advanceTo(t0);
+    REQUIRE_MESSAGE(t0 + 1h == ttt::VirtualClock::now(),
+                    "Time cannot move backwards");
+
+    ttt::VirtualClock::advanceTo(t0 + 2h);
+    REQUIRE_MESSAGE(t0 + 2h == ttt::VirtualClock::now(), "Advance failed");
+}
+
+TEST_CASE("Virtual clock notifies subscribers")
+{
+    std::atomic_size_t calls{0};
+    {
+        auto subscription =
+            ttt::VirtualClock::subscribe([&calls] { ++calls; });
+        ttt::VirtualClock::advance(1s);
+        ttt::VirtualClock::advance(1s);
+    }
+    ttt::VirtualClock::advance(1s);
+
+    REQUIRE_MESSAGE(2 == calls.load(), "Unsubscribed callbacks were invoked");
+}
+
+TEST_CASE("Tasks wait for virtual time")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Finished;
+    };
+
+    VirtualScheduler plan;
+    auto tkn = plan.add(fun, 1h, false);
+
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_MESSAGE(0 == callCount.load(), "Task ran before its time");
+
+    ttt::VirtualClock::advance(59min);
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_MESSAGE(0 == callCount.load(), "Task ran before its time");
+
+    ttt::VirtualClock::advance(1min);
+    REQUIRE_MESSAGE(Reaches(callCount, 1), "Task did not run when due");
+}
+
+TEST_CASE("Replay a day of repeating tasks")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    VirtualScheduler plan;
+    auto tkn = plan.add(fun, 1min, false);
+
+    const std::size_t minutesInDay{24 * 60};
+    for (std::size_t i = 1; i <= minutesInDay; ++i)
+    {
+        ttt::VirtualClock::advance(1min);
+        REQUIRE_MESSAGE(Reaches(callCount, i), "Missed a repetition");
+    }
+}
+
+TEST_CASE("Fast forward over many tasks")
+{
+    const std::size_t nTasks{10'000};
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Finished;
+    };
+
+    VirtualScheduler plan(true, 2);
+    std::vector<ttt::CallToken> tokens;
+    tokens.reserve(nTasks);
+    for (std::size_t i = 0; i < nTasks; ++i)
+    {
+        tokens.emplace_back(plan.add(fun, std::chrono::seconds(i + 1), false));
+    }
+
+    ttt::VirtualClock::advance(std::chrono::seconds(nTasks / 2));
+    REQUIRE_MESSAGE(Reaches(callCount, nTasks / 2), "Due tasks did not run");
+
+    ttt::VirtualClock::advance(std::chrono::seconds(nTasks));
+    REQUIRE_MESSAGE(Reaches(callCount, nTasks), "Due tasks did not run");
+}
+
+TEST_CASE("Deterministic replay on an embedded scheduler")
+{
+    std::size_t fastCalls{0}, slowCalls{0};
+
+    ttt::BasicCallScheduler<ttt::VirtualClock> plan(ttt::kEmbedded);
+    auto fast = plan.add(
+        [&fastCalls] {
+            ++fastCalls;
+            return ttt::Result::Repeat;
+        },
+        1s, false);
+    auto slow = plan.add(
+        [&slowCalls] {
+            ++slowCalls;
+            return ttt::Result::Repeat;
+        },
+        1h, false);
+
+    // Jump from deadline to deadline, i.e. no time is spent idling.
+    auto const end = ttt::VirtualClock::now() + 24h;
+    for (auto next = plan.nextDeadline(); next && *next <= end;
+         next = plan.nextDeadline())
+    {
+        ttt::VirtualClock::advanceTo(*next);
+        plan.runDue();
+    }
+
+    REQUIRE_MESSAGE(24 * 60 * 60 == fastCalls, "Wrong number of repetitions");
+    REQUIRE_MESSAGE(24 == slowCalls, "Wrong number of repetitions");
+}
+
+TEST_CASE("Rate limited lanes defer tasks to their next token")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Finished;
+    };
+
+    VirtualScheduler plan;
+    auto const store = plan.addLane("store");
+    CHECK_THROWS_WITH_AS(plan.setLaneLimit(store, ttt::RateLimit{});
+                         , ttt::detail::kErrorInvalidRate, std::runtime_error);
+    plan.setLaneLimit(store, ttt::RateLimit{.interval = 1s, .burst = 2});
+
+    std::vector<ttt::CallToken> tokens;
+    for (int i = 0; i < 6; ++i)
+    {
+        tokens.emplace_back(
+            plan.add(fun, 1h, ttt::TaskOptions{.immediate = true,
+                                               .lane = store}));
+    }
+
+    // A burst runs right away, then a task per interval.
+    REQUIRE_MESSAGE(Reaches(callCount, 2), "Burst did not run");
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_MESSAGE(2 == callCount.load(), "Rate limit exceeded");
+
+    ttt::VirtualClock::advance(1s);
+    REQUIRE_MESSAGE(Reaches(callCount, 3), "Deferred task did not run");
+    ttt::VirtualClock::advance(1s);
+    REQUIRE_MESSAGE(Reaches(callCount, 4), "Deferred task did not run");
+    ttt::VirtualClock::advance(2s);
+    REQUIRE_MESSAGE(Reaches(callCount, 6), "Deferred task did not run");
+
+    auto const stats = plan.laneStats(store);
+    REQUIRE(stats);
+    CHECK(4 == stats->deferred);
+
+    // Unlimited lanes do not defer.
+    plan.setLaneLimit(store, std::nullopt);
+    for (int i = 0; i < 4; ++i)
+    {
+        tokens.emplace_back(
+            plan.add(fun, 1h, ttt::TaskOptions{.immediate = true,
+                                               .lane = store}));
+    }
+    REQUIRE_MESSAGE(Reaches(callCount, 10), "Unlimited lane deferred tasks");
+}
+
+TEST_CASE("Tasks choose their next execution")
+{
+    // Exponential backoff while idle, then a fixed time point.
+    std::vector<ttt::VirtualClock::duration> runs;
+    auto const t0 = ttt::VirtualClock::now();
+    auto backoff = 1s;
+
+    ttt::BasicCallScheduler<ttt::VirtualClock> plan(ttt::kEmbedded);
+    auto token = plan.add(
+        [&] {
+            runs.push_back(ttt::VirtualClock::now() - t0);
+            if (runs.size() < 4)
+            {
+                auto const ret = ttt::Result::repeatAfter(backoff);
+                backoff *= 2;
+                return ret;
+            }
+            if (runs.size() == 4)
+            {
+                return ttt::Result::repeatAt(t0 + 1h);
+            }
+            return runs.size() < 6 ? ttt::Result(ttt::Result::Repeat)
+                                   : ttt::Result(ttt::Result::Finished);
+        },
+        1min, true);
+
+    for (auto next = plan.nextDeadline(); next; next = plan.nextDeadline())
+    {
+        ttt::VirtualClock::advanceTo(*next);
+        plan.runDue();
+    }
+
+    // Repeating on the interval resumes after the chosen executions.
+    std::vector<ttt::VirtualClock::duration> const expected{
+        0s, 1s, 3s, 7s, 1h, 1h + 1min};
+    REQUIRE(expected == runs);
+}
+
+TEST_CASE("Time points of other clocks are converted")
+{
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    auto token = plan.add(
+        [] {
+            return ttt::Result::repeatAt(std::chrono::system_clock::now() + 1h);
+        },
+        1min, true);
+
+    auto const before = std::chrono::steady_clock::now();
+    REQUIRE(1 == plan.runDue());
+    auto const after = std::chrono::steady_clock::now();
+
+    // Due an hour from the execution, not at the system clock's epoch count.
+    auto const next = plan.nextDeadline();
+    REQUIRE(next);
+    CHECK(*next >= before + 1h);
+    CHECK(*next <= after + 1h + 1ms);
+}
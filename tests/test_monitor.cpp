@@ -0,0 +1,128 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/monitor.h"
+#include "task_timetable/scheduler.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Scheduler metrics count overdue tasks")
+{
+    auto fun = [] { return ttt::Result::Finished; };
+
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    auto now = plan.add(
+        {{fun, std::chrono::hours(1)}, {fun, std::chrono::hours(1)}}, true);
+    auto later = plan.add(fun, std::chrono::hours(1), false);
+
+    auto metrics = plan.metrics();
+    CHECK(2 == metrics.overdue);
+    CHECK(metrics.queueDepths.empty());
+
+    CHECK(2 == plan.runDue());
+    metrics = plan.metrics();
+    CHECK(0 == metrics.overdue);
+    CHECK(0 == metrics.wakeups);
+}
+
+TEST_CASE("Scheduler metrics count spurious wake ups")
+{
+    auto fun = [] { return ttt::Result::Finished; };
+    // Wait (in real time) until the coordinator has woken up enough times.
+    auto wakeups = [](auto const &plan, std::uint64_t expected) {
+        auto start = test::now();
+        while (plan.metrics().wakeups < expected && test::delta(start) < 1s)
+        {
+            std::this_thread::yield();
+        }
+        return plan.metrics();
+    };
+
+    // Condition variables may wake up spuriously on their own, so counts
+    // are bounded rather than exact.
+    constexpr std::uint64_t kSlack = 2;
+    auto checkWakeups = [](ttt::SchedulerMetrics const &metrics,
+                           std::uint64_t wakeups, std::uint64_t spurious) {
+        CHECK(metrics.wakeups >= wakeups);
+        CHECK(metrics.wakeups <= wakeups + kSlack);
+        CHECK(metrics.spuriousWakeups >= spurious);
+        CHECK(metrics.spuriousWakeups <= spurious + kSlack);
+    };
+
+    ttt::CallScheduler plan;
+    std::this_thread::sleep_for(10ms); // Let the coordinator wait for tasks.
+    auto first = plan.add(fun, std::chrono::hours(1));
+    checkWakeups(wakeups(plan, 1), 1, 0);
+
+    // A later task notifies the coordinator without preempting its wait.
+    auto second = plan.add(fun, std::chrono::hours(2));
+    checkWakeups(wakeups(plan, 2), 2, 1);
+
+    // Same for virtual time, advanced short of the due time.
+    ttt::BasicCallScheduler<ttt::VirtualClock> virtualPlan;
+    std::this_thread::sleep_for(10ms);
+    auto third = virtualPlan.add(fun, std::chrono::hours(1));
+    checkWakeups(wakeups(virtualPlan, 1), 1, 0);
+
+    ttt::VirtualClock::advance(1min);
+    checkWakeups(wakeups(virtualPlan, 2), 2, 1);
+}
+
+TEST_CASE("Monitor notifies sustained overload and recovery")
+{
+    std::atomic_size_t callCount{0};
+    auto slow = [&callCount] {
+        std::this_thread::sleep_for(2ms);
+        ++callCount;
+        return ttt::Result::Finished;
+    };
+
+    std::atomic_size_t overloads{0}, recoveries{0};
+    std::atomic_size_t peakDepth{0};
+
+    ttt::CallScheduler plan;
+    ttt::SchedulerMonitor monitor(plan, 5ms);
+    monitor.addRule(
+        [](ttt::SchedulerLoad const &load) {
+            return load.metrics.queueDepths.at(0) > 10;
+        },
+        20ms,
+        [&](ttt::SchedulerLoad const &load) {
+            peakDepth = load.metrics.queueDepths.at(0);
+            ++overloads;
+        },
+        [&](ttt::SchedulerLoad const &) { ++recoveries; });
+
+    std::vector<std::pair<std::function<ttt::Result()>,
+                          std::chrono::microseconds>>
+        calls(100, {slow, std::chrono::hours(1)});
+    std::this_thread::sleep_for(10ms); // Let the coordinator wait for tasks.
+    auto tokens = plan.add(std::move(calls), true);
+
+    auto start = test::now();
+    while (0 == recoveries)
+    {
+        if (test::delta(start) > 5s)
+        {
+            FAILED_REQUIREMENT("Monitor did not notify recovery");
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+
+    CHECK(1 == overloads);
+    CHECK(peakDepth > 10);
+    CHECK(callCount >= 80);
+
+    auto const load = monitor.latest();
+    REQUIRE(load);
+    CHECK(load->metrics.wakeups > 0);
+    CHECK(load->busyRatio >= 0);
+    CHECK(load->busyRatio <= 1);
+}
@@ -0,0 +1,176 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/persistence.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ttt::TimelineStore;
+using ttt::TimerState;
+
+using namespace std::chrono_literals;
+
+namespace fs = std::filesystem;
+
+constexpr char kJournalPrefix[] = "timeline.journal.";
+
+static void DummyTimerAction(TimerState const &)
+{
+}
+
+// Store directory that is removed at the end of a test.
+struct ScratchDir
+{
+    fs::path path;
+
+    explicit ScratchDir(std::string const &name)
+        : path(fs::temp_directory_path() / ("ttt_" + name))
+    {
+        fs::remove_all(path);
+    }
+
+    ~ScratchDir()
+    {
+        fs::remove_all(path);
+    }
+};
+
+static std::vector<std::string> Sorted(std::vector<std::string> states)
+{
+    std::sort(states.begin(), states.end());
+    return states;
+}
+
+static std::size_t JournalCount(fs::path const &dir)
+{
+    auto isJournal = [](fs::directory_entry const &entry) {
+        return entry.path().filename().string().starts_with(kJournalPrefix);
+    };
+    return std::count_if(fs::directory_iterator(dir), fs::directory_iterator{},
+                         isJournal);
+}
+
+TEST_CASE("Restore a timeline from its journal")
+{
+    ScratchDir dir("journal");
+    std::vector<std::string> expected;
+
+    {
+        TimelineStore store(dir.path, DummyTimerAction);
+        auto &tl = store.timeline();
+        REQUIRE(tl.timerAdd("t1", 1s, 10s, true, DummyTimerAction, false));
+        REQUIRE(tl.timerAdd("t2", 1s, 10s, false, DummyTimerAction, false));
+        REQUIRE(tl.timerAdd("t3", 1s, 10s, false, DummyTimerAction, false));
+        REQUIRE(tl.timerStop("t2"));
+        REQUIRE(tl.timerRemove("t3"));
+        REQUIRE(tl.timerAdd("t4", 100ms, 5s, true, DummyTimerAction, false));
+        REQUIRE(tl.timerPause("t4"));
+
+        expected = Sorted(tl.serialize(true, true, true));
+        REQUIRE(3 == expected.size());
+    } // No snapshot is taken on destruction, as in a crash.
+
+    TimelineStore restored(dir.path, DummyTimerAction);
+    REQUIRE_MESSAGE(expected ==
+                        Sorted(restored.timeline().serialize(true, true, true)),
+                    "Journaled changes were not restored");
+    REQUIRE_MESSAGE(1 == JournalCount(dir.path),
+                    "Replayed journals should be dropped");
+}
+
+TEST_CASE("Timer observers do not replace the journal")
+{
+    ScratchDir dir("observer");
+    std::size_t nObserved = 0;
+
+    {
+        TimelineStore store(dir.path, DummyTimerAction);
+        auto &tl = store.timeline();
+        tl.setTimersObserver(
+            [&nObserved](ttt::TimerChange, TimerState const &) {
+                ++nObserved;
+            });
+        REQUIRE(tl.timerAdd("t1", 1s, 10s, true, DummyTimerAction, false));
+        tl.setTimersObserver(nullptr);
+        REQUIRE(tl.timerAdd("t2", 1s, 10s, true, DummyTimerAction, false));
+        REQUIRE(store.healthy());
+    }
+
+    REQUIRE(1 == nObserved);
+    TimelineStore restored(dir.path, DummyTimerAction);
+    REQUIRE_MESSAGE(2 == restored.timeline().serialize(true, true, true).size(),
+                    "Changes made while observed were not journaled");
+}
+
+TEST_CASE("Compact the journal into a snapshot")
+{
+    ScratchDir dir("compaction");
+    const std::size_t nTimers = 1'000;
+    std::vector<std::string> expected;
+
+    {
+        TimelineStore store(dir.path, DummyTimerAction, nullptr, 64);
+        auto &tl = store.timeline();
+        for (std::size_t i = 0; i < nTimers; ++i)
+        {
+            auto name = std::string("t").append(std::to_string(i));
+            REQUIRE(tl.timerAdd(name, 1s, 10s, true, DummyTimerAction, false));
+            if (i % 2)
+            {
+                REQUIRE(tl.timerRemove(name));
+            }
+        }
+
+        auto start = test::now();
+        while (JournalCount(dir.path) > 2)
+        {
+            if (test::delta(start) > 5s)
+            {
+                FAILED_REQUIREMENT("Journals were not compacted");
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+
+        store.compact();
+        expected = Sorted(tl.serialize(true, true, true));
+    }
+    REQUIRE(1 == JournalCount(dir.path)); // Background compactions finished.
+
+    TimelineStore restored(dir.path, DummyTimerAction);
+    REQUIRE(nTimers / 2 == expected.size());
+    REQUIRE_MESSAGE(expected ==
+                        Sorted(restored.timeline().serialize(true, true, true)),
+                    "Compacted state was not restored");
+}
+
+TEST_CASE("Ignore a torn journal record")
+{
+    ScratchDir dir("torn");
+
+    {
+        TimelineStore store(dir.path, DummyTimerAction);
+        REQUIRE(store.timeline().timerAdd("t1", 1s, 10s, true,
+                                          DummyTimerAction, false));
+    }
+
+    // Partial record, as left by a crash in the middle of a write.
+    for (auto const &entry : fs::directory_iterator(dir.path))
+    {
+        if (entry.path().filename().string().starts_with(kJournalPrefix))
+        {
+            std::ofstream(entry.path(), std::ios::binary | std::ios::app)
+                << '\x01' << '\x00';
+        }
+    }
+
+    TimelineStore restored(dir.path, DummyTimerAction);
+    auto state = restored.timeline().serialize(true, false, false);
+    REQUIRE(1 == state.size());
+    REQUIRE(state.front().starts_with("timer:t1:"));
+}
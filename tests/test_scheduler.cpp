@@ -1,12 +1,20 @@
 // © 2022 Nikolaos Athanasiou, github.com/picanumber
 #include "doctest/doctest.h"
+#include "task_timetable/return_channel.h"
 #include "task_timetable/scheduler.h"
+#include "task_timetable/spin_lock.h"
+#include "task_timetable/task_queue.h"
+#include "task_timetable/worker_group.h"
 #include "test_utils.h"
 
 #include <atomic>
 #include <functional>
+#include <memory>
+#include <optional>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 using namespace std::chrono_literals;
@@ -269,3 +277,527 @@ TEST_CASE("Check granularity")
     }
 }
 #endif
+
+TEST_CASE("Embedded scheduler runs tasks on the calling thread")
+{
+    std::atomic_size_t callCount{0};
+    std::thread::id runner;
+    auto fun = [&] {
+        runner = std::this_thread::get_id();
+        ++callCount;
+        return callCount < 3 ? ttt::Result::Repeat : ttt::Result::Finished;
+    };
+
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    REQUIRE_MESSAGE(!plan.nextDeadline(), "No deadline without tasks");
+
+    auto tkn = plan.add(fun, 1ms, true);
+    REQUIRE_MESSAGE(plan.nextDeadline(), "Added task has a deadline");
+
+    std::this_thread::sleep_for(5ms);
+    REQUIRE_MESSAGE(0 == callCount, "Embedded schedulers run no threads");
+
+    for (std::size_t i = 1; i <= 3; ++i)
+    {
+        auto deadline = plan.nextDeadline();
+        REQUIRE(deadline);
+        REQUIRE_MESSAGE(1 == plan.runDue(*deadline), "Task is due");
+        REQUIRE_MESSAGE(i == callCount, "Task should run once per deadline");
+        REQUIRE_MESSAGE(std::this_thread::get_id() == runner,
+                        "Tasks run on the caller thread");
+    }
+
+    REQUIRE_MESSAGE(!plan.nextDeadline(), "Finished tasks are not re-armed");
+    REQUIRE_MESSAGE(0 == plan.runDue(), "No tasks left");
+}
+
+TEST_CASE("Embedded scheduler honors tokens")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::CallScheduler plan(ttt::kEmbedded, false);
+    auto start = test::now();
+    {
+        auto tkn = plan.add(fun, 1ms, false);
+        REQUIRE_MESSAGE(0 == plan.runDue(start), "Task is not due yet");
+        REQUIRE_MESSAGE(1 == plan.runDue(start + 1s), "Task is due");
+        REQUIRE_MESSAGE(1 == callCount, "Task should have run");
+    }
+
+    // The cancelled task is dropped the next time it is due.
+    REQUIRE(plan.nextDeadline());
+    REQUIRE_MESSAGE(1 == plan.runDue(start + 1h), "Cancelled task is due");
+    REQUIRE_MESSAGE(1 == callCount, "Cancelled task should not run");
+    REQUIRE_MESSAGE(!plan.nextDeadline(), "Cancelled tasks are dropped");
+
+    ttt::CallScheduler threaded;
+    CHECK_THROWS_WITH_AS(threaded.runDue();
+                         , ttt::detail::kErrorNotEmbedded, std::runtime_error);
+
+    // The mode outlives the coordinator thread.
+    threaded.shutdown(test::now());
+    CHECK_THROWS_WITH_AS(threaded.runDue();
+                         , ttt::detail::kErrorNotEmbedded, std::runtime_error);
+    CHECK_NOTHROW(threaded.addLane("io"));
+}
+
+static void CheckShutdown(std::string const &prefix, ttt::CallScheduler &plan)
+{
+    std::atomic_size_t dueCalls{0}, lateCalls{0}, repeatCalls{0};
+
+    auto due = [&dueCalls] {
+        std::this_thread::sleep_for(100us);
+        ++dueCalls;
+        return ttt::Result::Finished;
+    };
+    auto late = [&lateCalls] {
+        ++lateCalls;
+        return ttt::Result::Finished;
+    };
+    auto repeat = [&repeatCalls] {
+        ++repeatCalls;
+        return ttt::Result::Repeat;
+    };
+
+    const std::size_t nDue{50};
+    std::vector<ttt::CallToken> tokens;
+    for (std::size_t i = 0; i < nDue; ++i)
+    {
+        tokens.emplace_back(plan.add(due, 200ms, false));
+    }
+    tokens.emplace_back(plan.add(late, 1h, false));
+    tokens.emplace_back(plan.add(repeat, 100ms, false));
+
+    auto start = test::now();
+    plan.shutdown(test::now() + 500ms);
+
+    CHECK_MESSAGE(test::delta(start) < 200ms,
+                  (prefix + "Draining should not wait for deadlines"));
+    CHECK_MESSAGE(nDue == dueCalls.load(),
+                  (prefix + "Tasks due before the deadline are lost"));
+    CHECK_MESSAGE(0 == lateCalls.load(),
+                  (prefix + "Tasks due after the deadline should not run"));
+    CHECK_MESSAGE(1 == repeatCalls.load(),
+                  (prefix + "Repeating tasks should run once"));
+
+    tokens.emplace_back(plan.add(late, 1us, true));
+    std::this_thread::sleep_for(10ms);
+    CHECK_MESSAGE(0 == lateCalls.load(),
+                  (prefix + "No tasks are accepted after shutdown"));
+
+    CHECK_NOTHROW(plan.shutdown(test::now() + 1h));
+}
+
+TEST_CASE("Shutdown drains due tasks")
+{
+    {
+        ttt::CallScheduler plan;
+        CheckShutdown("plan1: ", plan);
+    }
+    {
+        ttt::CallScheduler plan(true, 4);
+        CheckShutdown("plan2: ", plan);
+    }
+    {
+        ttt::CallScheduler plan(ttt::kEmbedded);
+        CheckShutdown("plan3: ", plan);
+    }
+}
+
+TEST_CASE("Shutdown drains more tasks than executors queue")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Finished;
+    };
+
+    // Beyond the default queue length of executors.
+    std::size_t const nTasks = 25'000;
+    std::vector<std::pair<std::function<ttt::Result()>,
+                          std::chrono::microseconds>>
+        calls(nTasks, {fun, std::chrono::hours(1)});
+
+    ttt::CallScheduler plan;
+    auto tokens = plan.add(std::move(calls));
+    plan.shutdown(test::now() + std::chrono::hours(2));
+
+    CHECK(nTasks == callCount);
+    CHECK(0 == plan.metrics().dropped);
+}
+
+TEST_CASE("Lanes isolate slow tasks")
+{
+    ttt::CallScheduler plan;
+    auto const slow = plan.addLane("slow");
+    REQUIRE(plan.findLane("slow") == slow);
+    REQUIRE(plan.findLane("default") == ttt::kDefaultLane);
+    REQUIRE_FALSE(plan.findLane("missing"));
+
+    CHECK_THROWS_WITH_AS(plan.addLane("slow");
+                         , ttt::detail::kErrorLaneExists, std::runtime_error);
+    CHECK_THROWS_WITH_AS(
+        auto token = plan.add([] { return ttt::Result::Finished; }, 1ms,
+                              ttt::TaskOptions{.lane = slow + 1});
+        , ttt::detail::kErrorUnknownLane, std::runtime_error);
+
+    std::atomic_size_t fastCount{0}, slowCount{0};
+    auto fastToken = plan.add(
+        [&fastCount] {
+            ++fastCount;
+            return ttt::Result::Repeat;
+        },
+        5ms, true);
+    auto slowToken = plan.add(
+        [&slowCount] {
+            ++slowCount;
+            std::this_thread::sleep_for(200ms);
+            return ttt::Result::Finished;
+        },
+        1ms, ttt::TaskOptions{.immediate = true, .lane = slow});
+
+    auto start = test::now();
+    while (slowCount == 0)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Task on a lane did not run");
+        }
+    }
+
+    // The slow task is still running, while the fast one keeps ticking.
+    auto const fastBefore = fastCount.load();
+    start = test::now();
+    while (fastCount < fastBefore + 5)
+    {
+        if (test::delta(start) > 150ms)
+        {
+            FAILED_REQUIREMENT("Slow lane delayed the default lane");
+        }
+    }
+
+    fastToken.detach();
+    slowToken.detach();
+    plan.shutdown(test::now());
+
+    auto const fastStats = plan.laneStats(ttt::kDefaultLane);
+    auto const slowStats = plan.laneStats(slow);
+    REQUIRE(fastStats);
+    REQUIRE(slowStats);
+    CHECK(fastStats->name == "default");
+    CHECK(fastStats->runs >= 5);
+    CHECK(slowStats->name == "slow");
+    CHECK(slowStats->workers == 1);
+    CHECK(slowStats->runs == 1);
+    CHECK(slowStats->busy >= 200ms);
+    CHECK(fastStats->maxDelay < 200ms);
+    CHECK_FALSE(plan.laneStats(slow + 1));
+}
+
+TEST_CASE("Embedded scheduler has no lanes")
+{
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    CHECK_THROWS_WITH_AS(plan.addLane("io");
+                         , ttt::detail::kErrorEmbeddedLanes,
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(plan.addLane("io", 0);
+                         , ttt::detail::kErrorNoWorkersInScheduler,
+                         std::runtime_error);
+}
+
+TEST_CASE("Task groups cancel all their tasks at once")
+{
+    const std::size_t nTasks = 100;
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::CallScheduler plan;
+    std::optional<ttt::TaskGroup> connection(std::in_place);
+    for (std::size_t i = 0; i < nTasks; ++i)
+    {
+        plan.add(*connection, fun, 1ms, ttt::TaskOptions{.immediate = true});
+    }
+
+    auto start = test::now();
+    while (callCount < 2 * nTasks)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Tasks of a group are not running");
+        }
+    }
+
+    connection->cancel();
+    std::this_thread::sleep_for(10ms); // Let running tasks finish.
+    auto const afterCancel = callCount.load();
+    std::this_thread::sleep_for(20ms);
+    CHECK_MESSAGE(afterCancel == callCount, "Cancelled group kept running");
+
+    // The group is reusable after cancellation.
+    plan.add(*connection, fun, 1ms, ttt::TaskOptions{.immediate = true});
+    start = test::now();
+    while (callCount < afterCancel + 3)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Tasks added after cancellation do not run");
+        }
+    }
+
+    connection.reset(); // Destruction cancels the group.
+    std::this_thread::sleep_for(10ms);
+    auto const afterDestruction = callCount.load();
+    std::this_thread::sleep_for(20ms);
+    CHECK_MESSAGE(afterDestruction == callCount,
+                  "Destroyed group kept running");
+}
+
+TEST_CASE("Cancelled task groups are reclaimed without running")
+{
+    std::size_t callCount = 0;
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    ttt::TaskGroup group;
+    for (int i = 0; i < 3; ++i)
+    {
+        plan.add(group, fun, 1h, ttt::TaskOptions{.immediate = true});
+    }
+    auto token = plan.add(fun, 1h, true);
+
+    group.cancel();
+    CHECK(4 == plan.runDue());
+    CHECK(1 == callCount);
+
+    // Only the task controlled by a token was re-armed.
+    plan.runDue(test::now() + 2h);
+    CHECK(2 == callCount);
+}
+
+TEST_CASE("Schedulers built from policies")
+{
+    static_assert(
+        std::is_same_v<ttt::CallScheduler,
+                       ttt::BasicCallScheduler<
+                           std::chrono::steady_clock, ttt::OrderedTaskQueue,
+                           std::function<ttt::Result()>, ttt::BufferedWorker,
+                           std::mutex>>);
+
+    // Stored inline, without type erasure.
+    struct Counter
+    {
+        std::atomic_size_t *calls;
+
+        ttt::Result operator()() const
+        {
+            ++*calls;
+            return ttt::Result::Repeat;
+        }
+    };
+
+    using LeanScheduler =
+        ttt::BasicCallScheduler<std::chrono::steady_clock,
+                                ttt::OrderedTaskQueue, Counter,
+                                ttt::BufferedWorker, ttt::SpinLock>;
+
+    std::atomic_size_t callCount{0}, otherCount{0};
+    LeanScheduler plan(true, 2);
+    auto token = std::optional(plan.add(Counter{&callCount}, 1ms, true));
+    auto other = plan.add(Counter{&otherCount}, 1ms, true);
+
+    auto start = test::now();
+    while (callCount < 5 || otherCount < 5)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Tasks of a policy scheduler are not running");
+        }
+    }
+
+    token.reset();
+    std::this_thread::sleep_for(10ms); // Let running tasks finish.
+    auto const afterCancel = callCount.load();
+    std::this_thread::sleep_for(20ms);
+    CHECK_MESSAGE(afterCancel == callCount, "Cancelled task kept running");
+    CHECK(otherCount > 5);
+}
+
+TEST_CASE("Policy alternatives satisfy the scheduler concepts")
+{
+    using task_t = std::function<void()>;
+    static_assert(ttt::TaskQueue<ttt::OrderedTaskQueue<int, task_t>>);
+    static_assert(ttt::TaskQueue<ttt::HeapTaskQueue<int, task_t>>);
+    static_assert(ttt::TaskExecutor<ttt::BufferedWorker<task_t>, task_t>);
+    static_assert(ttt::TaskExecutor<ttt::WorkerGroup<task_t>, task_t>);
+
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::BasicCallScheduler<std::chrono::steady_clock, ttt::HeapTaskQueue,
+                            std::function<ttt::Result()>, ttt::WorkerGroup>
+        plan(true, 1);
+    auto tokens = plan.add({{fun, 1ms}, {fun, 2ms}, {fun, 3ms}}, true);
+
+    auto start = test::now();
+    while (callCount < 30)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Tasks of a heap scheduler are not running");
+        }
+    }
+    CHECK(plan.metrics().dropped == 0);
+}
+
+template <template <class, class> class Queue> void checkTaskQueue()
+{
+    using queue_t = Queue<int, char>;
+    using node_t = typename queue_t::node_type;
+
+    queue_t queue;
+    std::vector<node_t const *> nodes;
+    for (int due : {5, 3, 8, 1, 9, 3, 7})
+    {
+        auto node = std::make_unique<node_t>(node_t{.due = due, .task = 'x'});
+        nodes.push_back(node.get());
+        queue.push(std::move(node));
+    }
+    CHECK(7 == queue.size());
+    CHECK(3 == queue.countUntil(3));
+    CHECK(1 == queue.top().due);
+
+    // Erase by handle, wherever the node is.
+    auto erased = queue.erase(nodes[2]);
+    REQUIRE(erased);
+    CHECK(8 == erased->due);
+    CHECK(!queue.erase(erased.get()));
+
+    std::vector<int> popped;
+    while (!queue.empty())
+    {
+        popped.push_back(queue.pop()->due);
+    }
+    CHECK(popped == std::vector<int>{1, 3, 3, 5, 7, 9});
+}
+
+TEST_CASE("Task queues hand out the earliest task")
+{
+    checkTaskQueue<ttt::OrderedTaskQueue>();
+    checkTaskQueue<ttt::HeapTaskQueue>();
+}
+
+TEST_CASE("Return channel hands over items from many producers")
+{
+    constexpr std::size_t kProducers = 4, kItems = 10'000;
+
+    struct Item
+    {
+        std::size_t producer;
+        std::size_t seq;
+        Item *next = nullptr;
+    };
+
+    ttt::detail::ReturnChannel<Item> channel;
+    std::vector<std::size_t> next(kProducers, 0);
+    std::size_t received = 0;
+    bool ordered = true;
+    auto consume = [&] {
+        received += channel.consume([&](std::unique_ptr<Item> &&item) {
+            ordered = ordered && next[item->producer] == item->seq;
+            next[item->producer] = item->seq + 1;
+        });
+    };
+
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&channel, p] {
+            for (std::size_t i = 0; i < kItems; ++i)
+            {
+                channel.push(std::make_unique<Item>(Item{p, i}));
+            }
+        });
+    }
+    while (received < kProducers * kItems)
+    {
+        consume();
+    }
+    for (auto &producer : producers)
+    {
+        producer.join();
+    }
+
+    CHECK(channel.empty());
+    CHECK_MESSAGE(ordered, "Items of a producer were reordered");
+}
+
+TEST_CASE("Re-arming repeating tasks does not allocate")
+{
+    using node_t = ttt::TaskNode<int, int>;
+
+    // Nodes are linked through their own member.
+    ttt::detail::ReturnChannel<node_t> channel;
+    auto node = std::make_unique<node_t>();
+    auto const before = test::allocations();
+    for (int i = 0; i < 100; ++i)
+    {
+        channel.push(std::move(node));
+        channel.consume([&node](std::unique_ptr<node_t> &&item) {
+            node = std::move(item);
+        });
+    }
+    CHECK(before == test::allocations());
+    CHECK(node);
+
+    // Tree nodes of the queue are reused.
+    auto fun = [] { return ttt::Result::Repeat; };
+    ttt::CallScheduler plan(ttt::kEmbedded);
+    auto tokens = plan.add({{fun, 1h}, {fun, 1h}, {fun, 1h}}, true);
+    auto const start = test::now();
+    CHECK(3 == plan.runDue(start)); // Sizes the reused buffers.
+
+    std::size_t runs = 0;
+    auto const warm = test::allocations();
+    for (int i = 1; i <= 100; ++i)
+    {
+        runs += plan.runDue(start + i * 1h);
+    }
+    CHECK(warm == test::allocations());
+    CHECK(300 == runs);
+}
+
+TEST_CASE("Re-armed tasks preempt the coordinator's wait")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::CallScheduler plan;
+    // The coordinator sleeps until this task, unless woken by earlier ones.
+    auto idle = plan.add([] { return ttt::Result::Repeat; }, 1h, false);
+    auto token = plan.add(fun, 1ms, true);
+
+    auto start = test::now();
+    while (callCount < 20)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Re-armed task did not wake the coordinator");
+        }
+    }
+}
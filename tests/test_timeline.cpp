@@ -4,10 +4,15 @@
 #include "task_timetable/timeline.h"
 #include "test_utils.h"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 using ttt::Timeline;
@@ -352,3 +357,773 @@ TEST_CASE("Timer: Pause-Resume")
     }
     // resetCalled = false, meaning the action completed successfully.
 }
+
+TEST_CASE("Many timers: add, remove and re-add by name")
+{
+    const std::size_t nTimers{20'000};
+
+    std::vector<std::string> entityStrings;
+    entityStrings.reserve(nTimers);
+    for (std::size_t i = 0; i < nTimers; ++i)
+    {
+        // Stopped timers, i.e. no scheduler activity.
+        entityStrings.emplace_back("timer:t" + std::to_string(i) +
+                                   ":100:500:500:1:0");
+    }
+
+    Timeline schedule(entityStrings, DummyTimerAction);
+    REQUIRE_MESSAGE(schedule.serialize(true, false, false).size() == nTimers,
+                    "All timers should be stored");
+
+    for (std::size_t i = 0; i < nTimers; i += 2)
+    {
+        auto const name = std::string("t").append(std::to_string(i));
+        REQUIRE(schedule.timerRemove(name));
+        REQUIRE_FALSE(schedule.timerRemove(name));
+    }
+    REQUIRE_MESSAGE(schedule.serialize(true, false, false).size() ==
+                        nTimers / 2,
+                    "Half of the timers should be removed");
+
+    // Removed names can be reused, existing ones cannot.
+    REQUIRE(schedule.timerAdd("t0", 1s, 10s, false, DummyTimerAction, false));
+    REQUIRE_FALSE(
+        schedule.timerAdd("t1", 1s, 10s, false, DummyTimerAction, false));
+    REQUIRE(schedule.timerPause("t0"));
+    REQUIRE(schedule.timerPause("t1"));
+    REQUIRE_FALSE(schedule.timerPause("t2"));
+
+    auto serialized = schedule.serialize(true, false, false);
+    REQUIRE(serialized.size() == nTimers / 2 + 1);
+    auto contains = [&serialized](std::string const &state) {
+        return serialized.end() !=
+               std::find(serialized.begin(), serialized.end(), state);
+    };
+    CHECK_MESSAGE(contains("timer:t0:1000:10000:10000:0:0"),
+                  "Re-added timer improperly serialized");
+    CHECK_MESSAGE(contains("timer:t1:100:500:500:1:0"),
+                  "Existing timer improperly serialized");
+}
+
+TEST_CASE("Timelines sharing a scheduler")
+{
+    auto scheduler = std::make_shared<ttt::CallScheduler>(true, 2);
+
+    std::atomic_size_t c1{0}, c2{0};
+    auto t1 = [&c1](TimerState const &) { ++c1; };
+    auto t2 = [&c2](TimerState const &) { ++c2; };
+
+    Timeline tl1(scheduler);
+    REQUIRE(tl1.timerAdd("t", 10ms, 1s, true, t1, true));
+
+    {
+        Timeline tl2({"timer:t:10:1000:1000:1:1"}, t2, scheduler);
+
+        auto start = test::now();
+        while (c1 < 3 || c2 < 3)
+        {
+            if (test::delta(start) > 1s)
+            {
+                FAILED_REQUIREMENT("Timers not ticking on shared scheduler");
+            }
+        }
+    }
+
+    // The scheduler outlives the destroyed timeline, whose timer stops.
+    const auto c2AfterDestruction = c2.load();
+    const auto c1AfterDestruction = c1.load();
+
+    auto start = test::now();
+    while (c1 < c1AfterDestruction + 3)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Surviving timeline should keep ticking");
+        }
+    }
+    REQUIRE_MESSAGE(c2AfterDestruction == c2.load(),
+                    "Timers of destroyed timelines should not tick");
+}
+
+TEST_CASE("Timers with slow callbacks run on their own lane")
+{
+    auto scheduler = std::make_shared<ttt::CallScheduler>();
+    auto const slow = scheduler->addLane("slow");
+
+    std::atomic_size_t fast{0}, blocked{0};
+    auto onFast = [&fast](TimerState const &) { ++fast; };
+    auto onSlow = [&blocked](TimerState const &) {
+        ++blocked;
+        std::this_thread::sleep_for(100ms);
+    };
+
+    Timeline schedule(scheduler);
+    CHECK_THROWS_WITH_AS(
+        schedule.timerAdd("bad", 10ms, 1s, true, onFast, true, {}, slow + 1);
+        , ttt::detail::kErrorUnknownLane, std::runtime_error);
+    REQUIRE_FALSE(schedule.timerHandle("bad"));
+
+    REQUIRE(schedule.timerAdd("io", 10ms, 1s, true, onSlow, true, {}, slow));
+    REQUIRE(schedule.timerAdd("ui", 10ms, 1s, true, onFast, true));
+
+    auto start = test::now();
+    while (fast < 20)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Slow timer delayed the default lane");
+        }
+    }
+    CHECK(blocked < 20);
+
+    // Resumed timers keep their lane.
+    auto const both = ttt::TimerSelection::names({"io", "ui"});
+    REQUIRE(2 == schedule.timersPause(both));
+    REQUIRE(2 == schedule.timersResume(both));
+    auto const runs = scheduler->laneStats(slow)->runs;
+    start = test::now();
+    while (scheduler->laneStats(slow)->runs == runs)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Resumed timer left its lane");
+        }
+    }
+}
+
+TEST_CASE("Binary serialization")
+{
+    std::vector<std::string> entityStrings{
+        "timer:t1:1000:10000:10000:1:1",
+        "timer:t2:1000:10000:7000:0:0",
+        "timer:a_longer_timer_name:100:500:0:1:0",
+    };
+    Timeline original(entityStrings, DummyTimerAction);
+
+    std::vector<std::byte> image;
+    auto const nBytes = original.serialize(image, true, true, true);
+    REQUIRE_MESSAGE(image.size() == nBytes, "Wrong image size reported");
+
+    Timeline restored(image, DummyTimerAction);
+    auto serialized = restored.serialize(true, true, true);
+    REQUIRE(entityStrings.size() == serialized.size());
+    for (auto const &ent : serialized)
+    {
+        CHECK_MESSAGE(entityStrings.end() != std::find(entityStrings.begin(),
+                                                       entityStrings.end(),
+                                                       ent),
+                      (ent + ": Entity improperly restored"));
+    }
+
+    // Images are appended, so a buffer can be reused to hold many of them.
+    REQUIRE(nBytes == restored.serialize(image, true, false, false));
+    REQUIRE(2 * nBytes == image.size());
+
+    // A record count beyond what the image can hold is rejected before
+    // anything is allocated for it.
+    std::vector<std::byte> inflated(image.begin(), image.begin() + nBytes);
+    std::fill(inflated.begin() + 8, inflated.begin() + 12, std::byte{0xFF});
+    CHECK_THROWS_AS(Timeline schedule(inflated, DummyTimerAction);
+                    , std::runtime_error);
+
+    auto truncated = std::span(image).first(nBytes - 1);
+    CHECK_THROWS_AS(Timeline schedule(truncated, DummyTimerAction);
+                    , std::runtime_error);
+    image.front() = std::byte{0};
+    CHECK_THROWS_AS(Timeline schedule(image, DummyTimerAction);
+                    , std::runtime_error);
+}
+
+TEST_CASE("Serialization runs concurrently with timer changes")
+{
+    Timeline schedule;
+    const std::size_t nTimers = 20'000;
+    auto name = [](std::size_t i) {
+        return std::string("t").append(std::to_string(i));
+    };
+    for (std::size_t i = 0; i < nTimers; ++i)
+    {
+        REQUIRE(schedule.timerAdd(name(i), 1s, 10s, false, nullptr, false));
+    }
+
+    std::atomic_bool done{false};
+    std::atomic_size_t nExports{0};
+    bool valid = true;
+    std::thread exporter([&] {
+        while (!done)
+        {
+            // Point-in-time views: at most the timer being re-added is missing.
+            auto state = schedule.serialize(true, false, false);
+            valid = valid && state.size() + 1 >= nTimers &&
+                    state.size() <= nTimers &&
+                    std::all_of(state.begin(), state.end(),
+                                [](std::string const &s) {
+                                    return s.starts_with("timer:t");
+                                });
+
+            std::vector<std::byte> image;
+            schedule.serialize(image, true, false, false);
+            ++nExports;
+        }
+    });
+
+    // Removed timers stay readable by the exports that captured them.
+    for (std::size_t round = 0; round < 3 || nExports < 3; ++round)
+    {
+        for (std::size_t i = 0; i < nTimers; ++i)
+        {
+            REQUIRE(schedule.timerRemove(name(i)));
+            REQUIRE(schedule.timerAdd(name(i), 1s, 10s, false, nullptr, false));
+        }
+    }
+    done = true;
+    exporter.join();
+
+    REQUIRE(valid);
+    REQUIRE(nTimers == schedule.serialize(true, false, false).size());
+}
+
+TEST_CASE("Bulk operations on groups, prefixes and names")
+{
+    using ttt::TimerSelection;
+
+    Timeline schedule;
+    const std::size_t nTimers = 1'000;
+    for (std::size_t i = 0; i < nTimers; ++i)
+    {
+        auto const id = std::to_string(i);
+        REQUIRE(schedule.timerAdd(std::string("a").append(id), 1s, 10s, true,
+                                  DummyTimerAction, false, "tenantA"));
+        REQUIRE(schedule.timerAdd(std::string("b").append(id), 1s, 10s, true,
+                                  DummyTimerAction, false, "tenantB"));
+    }
+
+    // State strings read "timer:<name>:...:<active>:<group>".
+    auto countActive = [&schedule](char namePrefix) {
+        std::size_t ret = 0;
+        for (auto const &state : schedule.serialize(true, false, false))
+        {
+            auto const head = state.substr(0, state.rfind(':'));
+            ret += state[6] == namePrefix && head.ends_with(":1");
+        }
+        return ret;
+    };
+
+    REQUIRE(nTimers == schedule.timersPause(TimerSelection::group("tenantA")));
+    REQUIRE(0 == countActive('a'));
+    REQUIRE(nTimers == countActive('b'));
+
+    REQUIRE(nTimers == schedule.timersResume(TimerSelection::prefix("a")));
+    REQUIRE(0 == schedule.timersResume(TimerSelection::prefix("a")));
+    REQUIRE(nTimers == countActive('a'));
+
+    auto const listed = TimerSelection::names({"a1", "b1", "a1"});
+    REQUIRE(2 == schedule.timersStop(listed)); // Listed twice, stopped once.
+    REQUIRE(nTimers - 1 == countActive('a'));
+    REQUIRE(2 == schedule.timersReset(TimerSelection::names({"a1", "b1"})));
+    REQUIRE(nTimers == countActive('a'));
+
+    REQUIRE(schedule.timerRemove("b7"));
+    REQUIRE(nTimers - 1 ==
+            schedule.timersRemove(TimerSelection::group("tenantB")));
+    REQUIRE(nTimers == schedule.serialize(true, false, false).size());
+    REQUIRE(0 == schedule.timersRemove(TimerSelection::group("tenantB")));
+}
+
+TEST_CASE("Groups survive serialization")
+{
+    std::vector<std::string> entityStrings{
+        "timer:t1:1000:10000:10000:1:1:g1",
+        "timer:t2:1000:10000:7000:0:0:g1",
+        "timer:t3:100:500:0:1:0",
+    };
+    Timeline original(entityStrings, DummyTimerAction);
+
+    std::vector<std::byte> image;
+    original.serialize(image, true, false, false);
+    Timeline restored(image, DummyTimerAction);
+
+    for (auto *tl : {&original, &restored})
+    {
+        auto serialized = tl->serialize(true, false, false);
+        std::sort(serialized.begin(), serialized.end());
+        REQUIRE(entityStrings == serialized);
+        REQUIRE(2 == tl->timersRemove(ttt::TimerSelection::group("g1")));
+    }
+}
+
+TEST_CASE("Timer snapshots without locking")
+{
+    Timeline schedule;
+    REQUIRE(schedule.timerAdd("t1", 1s, 10s, false, DummyTimerAction, false));
+    REQUIRE(schedule.timerAdd("t2", 1s, 5s, true, DummyTimerAction, false));
+    REQUIRE_FALSE(schedule.timerHandle("t3").has_value());
+
+    auto h1 = schedule.timerHandle("t1");
+    REQUIRE(h1.has_value());
+    REQUIRE("t1" == schedule.timerName(*h1));
+
+    auto snap = schedule.timerSnapshot(*h1);
+    REQUIRE(snap.has_value());
+    REQUIRE(1s == snap->resolution);
+    REQUIRE(10s == snap->duration);
+    REQUIRE(10s == snap->remaining);
+    REQUIRE_FALSE(snap->repeating);
+    REQUIRE(snap->active);
+
+    REQUIRE(schedule.timerPause("t1"));
+    REQUIRE_FALSE(schedule.timerSnapshot(*h1)->active);
+    REQUIRE(schedule.timerResume("t1"));
+    REQUIRE(schedule.timerSnapshot(*h1)->active);
+    REQUIRE(1u == schedule.timersPause(ttt::TimerSelection::names({"t2"})));
+    REQUIRE_FALSE(schedule.timerSnapshot(*schedule.timerHandle("t2"))->active);
+
+    std::vector<std::string> visited;
+    schedule.timersSnapshot(
+        [&](ttt::TimerHandle h, ttt::TimerSnapshot const &) {
+            visited.push_back(*schedule.timerName(h));
+        });
+    std::sort(visited.begin(), visited.end());
+    REQUIRE(std::vector<std::string>{"t1", "t2"} == visited);
+
+    // Handles of removed timers stay invalid when their slot is reused.
+    REQUIRE(schedule.timerRemove("t1"));
+    REQUIRE_FALSE(schedule.timerSnapshot(*h1).has_value());
+    REQUIRE(schedule.timerAdd("t3", 1s, 10s, false, DummyTimerAction, false));
+    REQUIRE_FALSE(schedule.timerSnapshot(*h1).has_value());
+    REQUIRE_FALSE(schedule.timerName(*h1).has_value());
+}
+
+TEST_CASE("Timer snapshots are consistent while ticking")
+{
+    Timeline schedule;
+    const std::size_t nTimers = 100;
+    for (std::size_t i = 0; i < nTimers; ++i)
+    {
+        auto name = std::string("t").append(std::to_string(i));
+        REQUIRE(schedule.timerAdd(name, 1ms, 10ms, true, DummyTimerAction,
+                                  false, "g"));
+    }
+
+    std::atomic_bool done{false};
+    std::thread toggler([&] {
+        while (!done)
+        {
+            schedule.timersPause(ttt::TimerSelection::group("g"));
+            schedule.timersResume(ttt::TimerSelection::group("g"));
+        }
+    });
+
+    std::size_t nVisited = 0;
+    bool valid = true;
+    auto start = test::now();
+    while (test::delta(start) < 200ms)
+    {
+        schedule.timersSnapshot(
+            [&](ttt::TimerHandle, ttt::TimerSnapshot const &snap) {
+                ++nVisited;
+                // Repeating timers never expose a zero countdown.
+                valid = valid && snap.remaining > 0ms &&
+                        snap.remaining <= snap.duration &&
+                        1ms == snap.resolution && snap.repeating;
+            });
+    }
+    done = true;
+    toggler.join();
+
+    REQUIRE(valid);
+    REQUIRE(nVisited >= nTimers);
+}
+
+TEST_CASE("Lazy timers only run on expiry")
+{
+    // An embedded scheduler shows which tasks are due.
+    auto scheduler = std::make_shared<ttt::CallScheduler>(ttt::kEmbedded);
+    Timeline schedule(scheduler);
+
+    std::vector<std::chrono::milliseconds> seen;
+    REQUIRE(schedule.timerAdd(
+        "lazy", ttt::kLazyResolution, 30ms, true,
+        [&seen](TimerState const &s) { seen.push_back(s.remaining); },
+        false));
+    REQUIRE(0 == scheduler->runDue()); // No ticks while counting down.
+
+    auto const h = *schedule.timerHandle("lazy");
+    auto const left = schedule.timerSnapshot(h)->remaining;
+    REQUIRE(left > 0ms);
+    REQUIRE(left <= 30ms);
+
+    // Repetitions count from the deadline, not from the late invocation.
+    std::this_thread::sleep_for(45ms);
+    REQUIRE(1 == scheduler->runDue());
+    REQUIRE(1 == seen.size());
+    REQUIRE(seen.front() <= 20ms);
+
+    REQUIRE(schedule.timerPause("lazy"));
+    auto const paused = schedule.timerSnapshot(h)->remaining;
+    std::this_thread::sleep_for(10ms);
+    REQUIRE(paused == schedule.timerSnapshot(h)->remaining);
+    REQUIRE(schedule.serialize(true, false, false).front().starts_with(
+        "timer:lazy:lazy:30:" + std::to_string(paused.count()) + ":1:0"));
+
+    std::size_t nExpired = 0;
+    REQUIRE(schedule.timerAdd(
+        "once", ttt::kLazyResolution, 20ms, false,
+        [&nExpired](TimerState const &s) {
+            nExpired += 0ms == s.remaining.load();
+        },
+        false));
+    std::this_thread::sleep_for(25ms);
+    scheduler->runDue();
+    std::this_thread::sleep_for(25ms);
+    scheduler->runDue();
+    REQUIRE(1 == nExpired);
+    REQUIRE(0ms == schedule.timerSnapshot(*schedule.timerHandle("once"))
+                       ->remaining);
+    REQUIRE(1 == seen.size()); // The paused timer did not run.
+}
+
+TEST_CASE("Lazy timers are flagged in serialized states")
+{
+    Timeline schedule;
+    REQUIRE(schedule.timerAdd("lazy", ttt::kLazyResolution, 1h, false,
+                              DummyTimerAction, false));
+    auto const h = *schedule.timerHandle("lazy");
+    REQUIRE(schedule.timerSnapshot(h)->lazy);
+    REQUIRE(schedule.timerPause("lazy"));
+
+    std::vector<std::byte> image;
+    schedule.serialize(image, true, false, false);
+    Timeline fromImage(image, DummyTimerAction);
+    CHECK(fromImage.timerSnapshot(*fromImage.timerHandle("lazy"))->lazy);
+
+    Timeline fromText(schedule.serialize(true, false, false),
+                      DummyTimerAction);
+    CHECK(fromText.timerSnapshot(*fromText.timerHandle("lazy"))->lazy);
+
+    // A zero resolution is not taken for laziness.
+    CHECK_THROWS_AS(Timeline restored(std::vector<std::string>{
+                                          "timer:t:0:3600000:3600000:0:0"},
+                                      DummyTimerAction);
+                    , std::runtime_error);
+    image[13] &= ~std::byte{0x08}; // Flags of the first record.
+    CHECK_THROWS_AS(Timeline restored(image, DummyTimerAction);
+                    , std::runtime_error);
+}
+
+TEST_CASE("Timer ticks are delivered in batches")
+{
+    // Delivered on the scheduler, then through a queue.
+    for (std::size_t maxQueued : {0u, 4u})
+    {
+        Timeline schedule;
+        std::mutex mtx;
+        std::size_t nBatches = 0, nTicks = 0;
+        bool valid = true;
+        schedule.setTimersBatchDelivery(
+            20ms,
+            [&](std::span<const ttt::TimerTick> batch) {
+                std::lock_guard<std::mutex> lock(mtx);
+                ++nBatches;
+                nTicks += batch.size();
+                for (auto const &tick : batch)
+                {
+                    valid = valid && tick.name.starts_with("t") &&
+                            1ms == tick.state.resolution && tick.state.active;
+                }
+            },
+            maxQueued);
+
+        std::atomic_size_t nDirect{0};
+        for (int i = 0; i < 10; ++i)
+        {
+            auto name = std::string("t").append(std::to_string(i));
+            REQUIRE(schedule.timerAdd(name, 1ms, 1s, true, nullptr, false));
+        }
+        REQUIRE(schedule.timerAdd(
+            "t_direct", 1ms, 1s, true,
+            [&nDirect](TimerState const &) { ++nDirect; }, false));
+
+        auto ticks = [&] {
+            std::lock_guard<std::mutex> lock(mtx);
+            return nTicks;
+        };
+        auto start = test::now();
+        while (ticks() < 200)
+        {
+            if (test::delta(start) > 2s)
+            {
+                FAILED_REQUIREMENT("Ticks were not delivered");
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+
+        schedule.setTimersBatchDelivery(20ms, nullptr);
+        auto const delivered = ticks();
+        std::this_thread::sleep_for(40ms);
+
+        std::lock_guard<std::mutex> lock(mtx);
+        REQUIRE(valid);
+        REQUIRE_MESSAGE(nBatches * 10 < nTicks, "Ticks were not batched");
+        REQUIRE_MESSAGE(delivered == nTicks, "Ticks delivered after stop");
+        REQUIRE(nDirect > 0); // Timer actions still run.
+    }
+}
+
+TEST_CASE("Pulse beats and liveness")
+{
+    Timeline schedule;
+    std::atomic_size_t nBeats{0};
+    REQUIRE(schedule.pulseAdd(
+        "p1", 10ms, [&nBeats](ttt::PulseState const &) { ++nBeats; }, true));
+    REQUIRE_FALSE(schedule.pulseAdd("p1", 10ms, nullptr, true));
+    REQUIRE(schedule.pulseAdd("quiet", 10ms, nullptr, true));
+
+    auto start = test::now();
+    while (nBeats < 5 || schedule.pulseStatus("quiet")->beats < 5)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Pulses are not beating");
+        }
+    }
+
+    auto status = schedule.pulseStatus("p1");
+    REQUIRE(status.has_value());
+    REQUIRE(status->active);
+    REQUIRE(std::chrono::system_clock::now() - status->lastBeat < 1s);
+
+    REQUIRE(schedule.pulsePause("p1"));
+    auto const paused = schedule.pulseStatus("p1")->beats;
+    std::this_thread::sleep_for(50ms);
+    REQUIRE_MESSAGE(paused == schedule.pulseStatus("p1")->beats,
+                    "Paused pulse kept beating");
+    REQUIRE_FALSE(schedule.pulseStatus("p1")->active);
+
+    REQUIRE(schedule.pulseResume("p1"));
+    start = test::now();
+    while (schedule.pulseStatus("p1")->beats == paused)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Resumed pulse is not beating");
+        }
+    }
+
+    REQUIRE(schedule.pulseRemove("p1"));
+    REQUIRE_FALSE(schedule.pulseStatus("p1").has_value());
+}
+
+TEST_CASE("Pulse serialization")
+{
+    using namespace std::chrono;
+    auto const secondAgo =
+        duration_cast<milliseconds>(
+            (system_clock::now() - 1s).time_since_epoch())
+            .count();
+
+    std::vector<std::string> entityStrings{
+        "pulse:active:100:" + std::to_string(secondAgo) + ":5:0:1",
+        "pulse:paused:100:" + std::to_string(secondAgo) + ":3:1:0",
+    };
+    Timeline original(entityStrings, DummyTimerAction);
+
+    // The pulse was not loaded for a second, i.e. about ten periods.
+    auto start = test::now();
+    while (original.pulseStatus("active")->beats < 6)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Loaded pulse is not beating");
+        }
+    }
+    REQUIRE(original.pulseStatus("active")->missed >= 8);
+
+    auto const paused = original.pulseStatus("paused");
+    REQUIRE_FALSE(paused->active);
+    REQUIRE(3 == paused->beats);
+    REQUIRE(1 == paused->missed);
+
+    REQUIRE(original.pulsePause("active"));
+    auto serialized = original.serialize(false, true, false);
+    std::sort(serialized.begin(), serialized.end());
+
+    std::vector<std::byte> image;
+    original.serialize(image, false, true, false);
+    Timeline restored(image, DummyTimerAction);
+    auto reserialized = restored.serialize(true, true, true);
+    std::sort(reserialized.begin(), reserialized.end());
+    REQUIRE(serialized == reserialized);
+}
+
+TEST_CASE("Alarms fire once, in deadline order")
+{
+    using std::chrono::system_clock;
+
+    std::mutex mtx;
+    std::vector<std::string> fired;
+    auto onFire = [&](ttt::AlarmState const &s) {
+        std::lock_guard<std::mutex> lock(mtx);
+        fired.push_back(s.name);
+    };
+    auto nFired = [&] {
+        std::lock_guard<std::mutex> lock(mtx);
+        return fired.size();
+    };
+
+    Timeline schedule;
+    auto const now = system_clock::now();
+    REQUIRE(schedule.alarmAdd("late", now + 60ms, onFire));
+    REQUIRE(schedule.alarmAdd("early", now + 20ms, onFire));
+    REQUIRE(schedule.alarmAdd("cancelled", now + 40ms, onFire));
+    REQUIRE_FALSE(schedule.alarmAdd("early", now, onFire));
+    REQUIRE(schedule.alarmRemove("cancelled"));
+    REQUIRE(2 == schedule.serialize(false, false, true).size());
+
+    auto start = test::now();
+    while (nFired() < 2)
+    {
+        if (test::delta(start) > 1s)
+        {
+            FAILED_REQUIREMENT("Alarms did not fire");
+        }
+    }
+    std::this_thread::sleep_for(50ms);
+
+    REQUIRE(std::vector<std::string>{"early", "late"} == fired);
+    REQUIRE(schedule.serialize(false, false, true).empty());
+    REQUIRE_FALSE(schedule.alarmRemove("late"));
+}
+
+TEST_CASE("Many alarms with cancellations")
+{
+    using std::chrono::system_clock;
+
+    const std::size_t nAlarms = 100'000;
+    std::size_t nFired = 0;
+    auto onFire = [&nFired](ttt::AlarmState const &) { ++nFired; };
+
+    // Nothing fires before runDue(), regardless of how long additions take.
+    auto scheduler = std::make_shared<ttt::CallScheduler>(ttt::kEmbedded);
+    Timeline schedule(scheduler);
+
+    auto name = [](std::size_t i) {
+        return std::string("a").append(std::to_string(i));
+    };
+    auto const now = system_clock::now();
+    for (std::size_t i = 0; i < nAlarms; ++i)
+    {
+        auto const deadline = now + std::chrono::microseconds(i);
+        REQUIRE(schedule.alarmAdd(name(i), deadline, onFire));
+    }
+    for (std::size_t i = 0; i < nAlarms; i += 2)
+    {
+        REQUIRE(schedule.alarmRemove(name(i)));
+    }
+
+    while (system_clock::now() <= now + std::chrono::microseconds(nAlarms))
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+    while (scheduler->runDue())
+    {
+    }
+    REQUIRE(nAlarms / 2 == nFired);
+    REQUIRE(schedule.serialize(false, false, true).empty());
+}
+
+TEST_CASE("Overdue alarms fire in one batch after loading")
+{
+    using namespace std::chrono;
+    auto millis = [](system_clock::time_point t) {
+        return duration_cast<milliseconds>(t.time_since_epoch()).count();
+    };
+    auto const past = millis(system_clock::now() - 1h);
+    auto const future = millis(system_clock::now() + 1h);
+
+    std::vector<std::string> entityStrings;
+    for (int i = 0; i < 1'000; ++i)
+    {
+        entityStrings.push_back("alarm:overdue" + std::to_string(i) + ":" +
+                                std::to_string(past + i));
+    }
+    entityStrings.push_back("alarm:pending:" + std::to_string(future));
+
+    // An embedded scheduler only runs tasks when asked to.
+    auto scheduler = std::make_shared<ttt::CallScheduler>(ttt::kEmbedded);
+    std::size_t nFired = 0;
+    Timeline schedule(entityStrings, DummyTimerAction, scheduler, nullptr,
+                      [&nFired](ttt::AlarmState const &) { ++nFired; });
+
+    std::vector<std::byte> image;
+    schedule.serialize(image, false, false, true);
+
+    REQUIRE(1 == scheduler->runDue());
+    REQUIRE(1'000 == nFired);
+    REQUIRE(std::vector<std::string>{entityStrings.back()} ==
+            schedule.serialize(true, true, true));
+
+    Timeline restored(image, DummyTimerAction, scheduler, nullptr,
+                      [&nFired](ttt::AlarmState const &) { ++nFired; });
+    REQUIRE(1 == scheduler->runDue());
+    REQUIRE(2'000 == nFired);
+}
+
+TEST_CASE("Overdue alarms in descending order share a pump")
+{
+    using namespace std::chrono;
+    auto const past = duration_cast<milliseconds>(
+                          (system_clock::now() - 1h).time_since_epoch())
+                          .count();
+
+    // Each deadline is earlier than the ones loaded before it.
+    std::vector<std::string> entityStrings;
+    for (int i = 1'000; i > 0; --i)
+    {
+        entityStrings.push_back("alarm:overdue" + std::to_string(i) + ":" +
+                                std::to_string(past + i));
+    }
+
+    auto scheduler = std::make_shared<ttt::CallScheduler>(ttt::kEmbedded);
+    std::size_t nFired = 0;
+    Timeline schedule(entityStrings, DummyTimerAction, scheduler, nullptr,
+                      [&nFired](ttt::AlarmState const &) { ++nFired; });
+
+    REQUIRE(1 == scheduler->runDue());
+    REQUIRE(1'000 == nFired);
+    REQUIRE_FALSE(scheduler->nextDeadline());
+}
+
+TEST_CASE("Alarms in descending order keep a single pump")
+{
+    using namespace std::chrono;
+    auto scheduler = std::make_shared<ttt::CallScheduler>(ttt::kEmbedded);
+    std::size_t nFired = 0;
+    auto onFire = [&nFired](ttt::AlarmState const &) { ++nFired; };
+
+    // Each deadline is earlier than the ones added before it, moving the
+    // pump earlier every time.
+    auto const base = system_clock::now() + 50ms;
+    {
+        Timeline schedule(scheduler);
+        for (int i = 0; i < 100; ++i)
+        {
+            schedule.alarmAdd("a" + std::to_string(i), base - i * 100us,
+                              onFire);
+        }
+
+        std::this_thread::sleep_for(100ms);
+        scheduler->runDue();
+        CHECK(100 == nFired);
+        CHECK(1 == scheduler->laneStats(ttt::kDefaultLane)->runs);
+
+        // Pumps are cancelled along with the timeline.
+        schedule.alarmAdd("late", system_clock::now() + 1ms, onFire);
+    }
+
+    std::this_thread::sleep_for(10ms);
+    scheduler->runDue();
+    CHECK(100 == nFired);
+    CHECK(1 == scheduler->laneStats(ttt::kDefaultLane)->runs);
+    CHECK_FALSE(scheduler->nextDeadline());
+}
@@ -0,0 +1,77 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/scheduler.h"
+#include "task_timetable/tracer.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Trace scheduler activity")
+{
+    std::atomic_size_t callCount{0};
+    auto fun = [&callCount] {
+        ++callCount;
+        return ttt::Result::Repeat;
+    };
+
+    ttt::Tracer::start();
+    REQUIRE(ttt::Tracer::enabled());
+    {
+        ttt::CallScheduler plan;
+        auto token = std::optional(plan.add(fun, 1ms, true));
+
+        auto start = test::now();
+        while (callCount < 3)
+        {
+            if (test::delta(start) > 1s)
+            {
+                FAILED_REQUIREMENT("Traced task is not running");
+            }
+        }
+        token.reset();
+    }
+    ttt::Tracer::stop();
+    REQUIRE_FALSE(ttt::Tracer::enabled());
+
+    std::ostringstream out;
+    auto const nEvents = ttt::Tracer::write(out);
+    auto const trace = out.str();
+
+    CHECK(nEvents >= 3 * 4); // Dispatch, run begin and end, re-arm.
+    CHECK(trace.starts_with(R"({"displayTimeUnit":"ns","traceEvents":[)"));
+    for (auto name : {"wake", "dispatch", "rearm", "cancel", "coordinator",
+                      "worker", R"("ph":"B")", R"("ph":"E")"})
+    {
+        CHECK_MESSAGE(std::string::npos != trace.find(name),
+                      std::string("Missing from trace: ") + name);
+    }
+
+    // Events are not recorded while tracing is stopped.
+    ttt::detail::trace('i', "ignored");
+    std::ostringstream again;
+    CHECK(nEvents == ttt::Tracer::write(again));
+}
+
+TEST_CASE("Trace rings keep the most recent events")
+{
+    ttt::Tracer::start(4);
+    for (int i = 0; i < 10; ++i)
+    {
+        ttt::detail::trace('i', "tick", i);
+    }
+    ttt::Tracer::stop();
+
+    std::ostringstream out;
+    REQUIRE(4 == ttt::Tracer::write(out));
+    CHECK(std::string::npos == out.str().find(R"("task":5,)"));
+    CHECK(std::string::npos != out.str().find(R"("task":6,)"));
+
+    CHECK_THROWS_WITH_AS(ttt::Tracer::write("/nonexistent/dir/trace.json");
+                         , ttt::detail::kErrorTraceFile, std::runtime_error);
+}
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
 #include <string>
 
 namespace test
@@ -28,6 +29,9 @@ auto delta(T const &start, T const &end)
     return std::chrono::duration_cast<D>(end - start);
 }
 
+// Number of allocations made by the calling thread so far.
+std::size_t allocations();
+
 #define FAILED_REQUIREMENT(msg)                                                \
     REQUIRE_MESSAGE(false == true, (std::string("Requirement failed: ") + msg))
 
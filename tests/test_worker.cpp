@@ -153,3 +153,55 @@ TEST_CASE("Execute no task - Kill before add")
     std::this_thread::yield();
     REQUIRE_MESSAGE(0 == totalCalls.load(), "Task executed on dead worker");
 }
+
+TEST_CASE("Wake a parked worker on every burst")
+{
+    using task_t = std::function<void()>;
+
+    ttt::BufferedWorker<task_t> worker;
+
+    const int bursts{20}, burstLen{5};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] { totalCalls += 1; };
+
+    for (int b(1); b <= bursts; ++b)
+    {
+        // Let the worker drain its buffers and park before the next burst.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (int i(0); i < burstLen; ++i)
+        {
+            worker.add(incr);
+        }
+
+        auto start = test::now();
+        while (b * burstLen != totalCalls.load())
+        {
+            REQUIRE_MESSAGE(test::delta(start).count() < 100,
+                            "Parked worker was not woken up");
+            std::this_thread::yield();
+        }
+    }
+}
+
+TEST_CASE("Drain a dropping worker")
+{
+    using task_t = std::function<void()>;
+
+    const int repetitions{100};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] {
+        std::this_thread::sleep_for(test::k10us);
+        totalCalls += 1;
+    };
+
+    ttt::BufferedWorker<task_t> worker;
+    for (int i(0); i < repetitions; ++i)
+    {
+        worker.add(incr);
+    }
+    worker.drain();
+
+    REQUIRE_MESSAGE(totalCalls == repetitions,
+                    "Draining executes all pending tasks");
+    REQUIRE_MESSAGE(false == worker.add(incr), "Drained worker accepted task");
+}
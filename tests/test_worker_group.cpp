@@ -0,0 +1,202 @@
+// © 2022 Nikolaos Athanasiou, github.com/picanumber
+#include "doctest/doctest.h"
+#include "task_timetable/worker_group.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+using task_t = std::function<void()>;
+
+TEST_CASE("Construction")
+{
+    CHECK_NOTHROW(ttt::WorkerGroup<task_t> group);
+    CHECK(ttt::WorkerGroup<task_t>().size() >= 1);
+    CHECK_NOTHROW(ttt::WorkerGroup<task_t> group(1));
+    CHECK_NOTHROW(ttt::WorkerGroup<task_t> group(4));
+    CHECK_NOTHROW(ttt::WorkerGroup<task_t> group(4, 1));
+    CHECK_NOTHROW(ttt::WorkerGroup<task_t> group(4, 1'000, false));
+
+    CHECK_THROWS_WITH_AS(ttt::WorkerGroup<task_t> group(0);
+                         , ttt::detail::kErrorWorkerGroupSize,
+                         std::runtime_error);
+    CHECK_THROWS_WITH_AS(ttt::WorkerGroup<task_t> group(2, 0);
+                         , ttt::detail::kErrorWorkerSize, std::runtime_error);
+}
+
+TEST_CASE("Execute all added tasks on the group")
+{
+    ttt::WorkerGroup<task_t> group(4);
+
+    const int repetitions{1'000};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] { totalCalls += 1; };
+
+    for (int i(0); i < repetitions; ++i)
+    {
+        group.add(incr);
+    }
+
+    auto start = test::now();
+    while (repetitions != totalCalls.load())
+    {
+        REQUIRE_MESSAGE(test::delta(start).count() < 100, "Tasks not executed");
+        std::this_thread::yield();
+    }
+}
+
+TEST_CASE("Tasks are spread over the group threads")
+{
+    const unsigned nWorkers{4};
+    ttt::WorkerGroup<task_t> group(nWorkers);
+
+    std::mutex mtx;
+    std::set<std::thread::id> consumers;
+    std::atomic_int totalCalls{0};
+
+    // Tasks block until every consumer has picked one up.
+    task_t record = [&] {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            consumers.insert(std::this_thread::get_id());
+        }
+        totalCalls += 1;
+
+        auto start = test::now();
+        while (totalCalls < int(nWorkers) && test::delta(start).count() < 500)
+        {
+            std::this_thread::yield();
+        }
+    };
+
+    for (unsigned i(0); i < nWorkers; ++i)
+    {
+        group.add(record);
+    }
+
+    auto start = test::now();
+    while (int(nWorkers) != totalCalls.load())
+    {
+        REQUIRE_MESSAGE(test::delta(start).count() < 1'000,
+                        "Tasks not executed");
+        std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    REQUIRE_MESSAGE(consumers.size() == nWorkers,
+                    "Each blocked task should occupy a distinct consumer");
+}
+
+TEST_CASE("Execute tasks until group destruction")
+{
+    const int repetitions{100};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] {
+        std::this_thread::sleep_for(test::k10us);
+        totalCalls += 1;
+    };
+
+    {
+        ttt::WorkerGroup<task_t> group(2);
+        for (int i(0); i < repetitions; ++i)
+        {
+            group.add(incr);
+        }
+    }
+
+    REQUIRE_MESSAGE(totalCalls < repetitions,
+                    "Group should have dropped tasks");
+}
+
+TEST_CASE("Execute tasks until destruction of non-dropping group")
+{
+    const int repetitions{100};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] {
+        std::this_thread::sleep_for(test::k10us);
+        totalCalls += 1;
+    };
+
+    {
+        ttt::WorkerGroup<task_t> group(2, 1'000, false);
+        // Group is not allowed to drop tasks    ^^^^^
+        for (int i(0); i < repetitions; ++i)
+        {
+            group.add(incr);
+        }
+    }
+
+    REQUIRE_MESSAGE(totalCalls == repetitions,
+                    "Group is not allowed to drop tasks");
+}
+
+TEST_CASE("Bounded group queue replaces older tasks")
+{
+    std::atomic_int totalCalls{0};
+    std::atomic_bool release{false};
+
+    {
+        ttt::WorkerGroup<task_t> group(1, 10, false);
+        group.add([&release] {
+            while (!release)
+            {
+                std::this_thread::yield();
+            }
+        });
+        // Let the single consumer pick up the blocking task.
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        for (int i(0); i < 100; ++i)
+        {
+            group.add([&totalCalls] { totalCalls += 1; });
+        }
+        // The blocking task is pending until it finishes.
+        CHECK(11 == group.pending());
+        CHECK(90 == group.dropped());
+        release = true;
+    }
+
+    REQUIRE_MESSAGE(totalCalls == 10, "Queue should be bounded by maxLen");
+}
+
+TEST_CASE("Execute no task on group - Kill before add")
+{
+    ttt::WorkerGroup<task_t> group(2);
+
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] { totalCalls += 1; };
+
+    REQUIRE_NOTHROW(group.kill());
+    for (int i(0); i < 100; ++i)
+    {
+        REQUIRE_MESSAGE(false == group.add(incr),
+                        "Dead group accepted a task");
+    }
+
+    std::this_thread::yield();
+    REQUIRE_MESSAGE(0 == totalCalls.load(), "Task executed on dead group");
+}
+
+TEST_CASE("Drain a dropping group")
+{
+    const int repetitions{100};
+    std::atomic_int totalCalls{0};
+    task_t incr = [&totalCalls] {
+        std::this_thread::sleep_for(test::k10us);
+        totalCalls += 1;
+    };
+
+    ttt::WorkerGroup<task_t> group(2);
+    for (int i(0); i < repetitions; ++i)
+    {
+        group.add(incr);
+    }
+    group.drain();
+
+    REQUIRE_MESSAGE(totalCalls == repetitions,
+                    "Draining executes all pending tasks");
+}